@@ -4,7 +4,7 @@
 /*
 /*
 /* @author langenhagen
-/* @version 150520
+/* @version 261016
 /******************************************************************************/
 #pragma once
 
@@ -29,16 +29,24 @@ namespace OPTICS {
 
     private: // vars
 
-        std::vector<real> _data;        ///< The data elements.
+        RealVector _data;               ///< The data elements.
         real _reachability_distance;    ///< The reachability distance.
+        real _core_distance;            ///< The core distance.
         bool _is_processed;             ///< A flag indicating if the object is already processed.
     
     public: // ctor & dtor
 
         /** Main constructor.
-         * Sets the reachability distance to OPTICS::UNDEFINED and sets the processed-flag to false.
+         * Sets the reachability distance and the core distance to OPTICS::UNDEFINED and sets the processed-flag to false.
          */
-        DataPoint() : _data( std::vector<real>()), _reachability_distance( UNDEFINED), _is_processed( false) 
+        DataPoint() : _data( RealVector()), _reachability_distance( UNDEFINED), _core_distance( UNDEFINED), _is_processed( false) 
+        {}
+
+        /** Allocator-aware constructor.
+         * Sets the reachability distance and the core distance to OPTICS::UNDEFINED and sets the processed-flag to false.
+         * @param alloc The allocator of the data vector.
+         */
+        explicit DataPoint( const Allocator<real>::type& alloc) : _data( alloc), _reachability_distance( UNDEFINED), _core_distance( UNDEFINED), _is_processed( false) 
         {}
 
         //
@@ -63,6 +71,19 @@ namespace OPTICS {
          * @return The reachability distance. Can be OPTICS::UNDEFINED.
          */
         inline real reachability_distance() const { return _reachability_distance; }
+
+        /** Sets the core distance.
+         * @param d The new core distance. The value must not be negative.
+         */
+        inline void core_distance( real d) {
+            assert( d>=0 && "Core distance must not be negative.");
+            _core_distance = d;
+        }
+
+        /** Retrieves the core distance that was found when the point was processed.
+         * @return The core distance. Is OPTICS::UNDEFINED if the point is no core point.
+         */
+        inline real core_distance() const { return _core_distance; }
     
         /** Sets the processed flag.
          * @param b The new processed flag.
@@ -77,13 +98,13 @@ namespace OPTICS {
         /** Retrieves a reference to the data vector.
          * @return A reference to the data vector that stores the data elements.
          */
-        inline std::vector<real>& data() { return _data; }
+        inline RealVector& data() { return _data; }
 
         /** Retrieves a const reference to a data vector.
          * Constant method.
          * @return A const reference to the data vector that stores the data elements.
          */
-        inline const std::vector<real>& data() const { return _data; }
+        inline const RealVector& data() const { return _data; }
 
     public: // operators
 
@@ -114,12 +135,20 @@ namespace OPTICS {
     public: // ctor & dtor
 
         /** Main constructor.
-         * Sets the reachability distance to OPTICS::UNDEFINED and sets the processed-flag to false.
+         * Sets the reachability distance and the core distance to OPTICS::UNDEFINED and sets the processed-flag to false.
          * @param label The label that will be stored within the object.
          */
         LabelledDataPoint( T label) : DataPoint(), _label(label)
         {}
 
+        /** Allocator-aware constructor.
+         * Sets the reachability distance and the core distance to OPTICS::UNDEFINED and sets the processed-flag to false.
+         * @param label The label that will be stored within the object.
+         * @param alloc The allocator of the data vector.
+         */
+        LabelledDataPoint( T label, const Allocator<real>::type& alloc) : DataPoint( alloc), _label(label)
+        {}
+
         //
         // Copy construction done by the compiler generated copy constructor.
         //
@@ -141,4 +170,59 @@ namespace OPTICS {
         inline const T& label() const { return _label; }
     };
 
+
+
+
+
+
+    /** Implements the points of a store that keeps its data outside of the data vectors, e.g. strings,
+     * binary codes or sparse rows. For every item, the store owns a DataPoint with an empty data vector
+     * that carries the state of the OPTICS algorithm; its index is found by pointer arithmetic.
+     * The stores derive from this class and run OPTICS with optics_indexed() and an index of their own.
+     */
+    class StatePoints {
+
+    protected: // vars
+
+        std::vector<DataPoint> _points; ///< The points, one per item.
+        DataVector _view;               ///< Pointers to the points.
+
+    protected: // ctor & dtor
+
+        /** Main constructor.
+         * @param n The number of items, i.e. points.
+         */
+        explicit StatePoints( const std::size_t n = 0) : _points( n) {
+            _view.reserve( n);
+            for( std::size_t i=0; i<n; ++i)
+                _view.push_back( &_points[i]);
+        }
+
+    private: // forbidden copy construction and assignment; the view points into the store
+
+        StatePoints( const StatePoints&);
+        StatePoints& operator=( const StatePoints&);
+
+    public: // methods
+
+        /** Retrieves the number of points.
+         * @return The number of points.
+         */
+        inline std::size_t size() const { return _points.size(); }
+
+        /** Retrieves pointers to all points, e.g. as the input of optics_indexed().
+         * @return A reference to the vector of pointers to the points.
+         */
+        inline DataVector& points() { return _view; }
+
+        /** Retrieves the index of a point within the store.
+         * @param p A point of this store.
+         * @return The index of the point.
+         */
+        inline std::size_t index_of( const DataPoint* p) const {
+            assert( !_points.empty() && p >= &_points.front() && p <= &_points.back() && "The point must belong to this store.");
+            return static_cast<std::size_t>(p - &_points.front());
+        }
+    };
+
 } // END namespace OPTICS
\ No newline at end of file
@@ -0,0 +1,123 @@
+/******************************************************************************
+/* @file Contains a batch API of the OPTICS algorithm that clusters many small,
+/*       independent datasets concurrently.
+/*
+/*
+/* @author langenhagen
+/* @version 261016
+/******************************************************************************/
+#pragma once
+
+///////////////////////////////////////////////////////////////////////////////
+// INCLUDES project headers
+
+#include "optics.hpp"
+#include "thread_pool.hpp"
+
+///////////////////////////////////////////////////////////////////////////////
+//INCLUDES C/C++ standard library (and other external libraries)
+
+#include <algorithm> // copy
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+// NAMESPACE, CONSTANTS and TYPE DECLARATIONS/IMPLEMENTATIONS
+
+namespace OPTICS {
+
+    /// A non-owning view on the points of one dataset, e.g. a range of a bigger DataVector.
+    struct DatasetView {
+        DataPoint* const* points;   ///< The first of the pointers to the points.
+        std::size_t size;           ///< The number of points.
+    };
+
+
+    /// The parameters of an OPTICS run.
+    struct Parameters {
+        real eps;               ///< The epsilon representing the radius of the epsilon-neighborhood. Can be OPTICS::UNDEFINED.
+        unsigned int min_pts;   ///< The minimum number of points to be found within an epsilon-neigborhood.
+    };
+
+
+    /** The packed result of optics_batch().
+     * The OPTICS ordering of the i-th dataset is the range [offsets[i], offsets[i+1]) of ordering.
+     */
+    struct BatchResult {
+        DataVector ordering;                ///< The OPTICS orderings of all datasets, one after another.
+        std::vector<std::size_t> offsets;   ///< The start of every dataset's ordering, plus the total size at the end.
+
+        /** Retrieves the number of datasets.
+         * @return The number of datasets.
+         */
+        inline std::size_t size() const { return offsets.empty() ? 0 : offsets.size()-1; }
+
+        /** Retrieves the OPTICS ordering of a dataset.
+         * @param idx The index of the dataset. Must be within the range of the batch.
+         * @return A view on the OPTICS ordered points of the dataset.
+         */
+        inline DatasetView operator[]( const std::size_t idx) const {
+            assert( idx < size() && "Index must be within the range of the batch.");
+            DatasetView ret = { ordering.data() + offsets[idx], offsets[idx+1] - offsets[idx] };
+            return ret;
+        }
+    };
+
+
+
+    // FUNCTION DECLARATIONS ######################################################################
+
+    BatchResult optics_batch( const std::vector<DatasetView>& datasets, const Parameters& params, ThreadPool& pool = default_pool());
+
+
+
+    // BATCH VERSION ##############################################################################
+
+
+    /** Performs the classic OPTICS algorithm on many independent datasets concurrently.
+     * The datasets are distributed over the threads of a pool in chunks. Every chunk runs its datasets
+     * one after another on a Workspace and scratch vectors of its own, so that, once these have grown
+     * to the size of the biggest dataset of the chunk, a job with a finite eps does not allocate.
+     * With eps = OPTICS::UNDEFINED, every job runs optics_unbounded(), which allocates its own
+     * KDTree and ordering. The orderings are written into one preallocated, contiguous output.
+     * The per-call overhead of optics() is thus paid once per chunk instead of once per dataset.
+     * @param datasets The datasets. Their points must be distinct and not yet processed. Changes the values of the points.
+     * @param params The parameters of the runs, the same for all datasets.
+     * @param pool The thread pool that runs the jobs.
+     * @return The OPTICS orderings of all datasets with reachability-distances and core-distances set.
+     *         Every ordering equals the result of optics() on the respective dataset.
+     */
+    BatchResult optics_batch( const std::vector<DatasetView>& datasets, const Parameters& params, ThreadPool& pool) {
+        assert( params.eps >= 0 && "eps must not be negative");
+        assert( params.min_pts > 0 && "min_pts must be greater than 0");
+
+        BatchResult ret;
+        ret.offsets.resize( datasets.size() + 1, 0);
+        for( std::size_t i=0; i<datasets.size(); ++i)
+            ret.offsets[i+1] = ret.offsets[i] + datasets[i].size;
+        ret.ordering.resize( ret.offsets.back(), nullptr);
+
+        pool.parallel_for( 0, datasets.size(), 1, [&]( const std::size_t lower_idx, const std::size_t upper_idx) {
+            Workspace ws;
+            DataVector db;
+            DataVector ordering;
+
+            for( std::size_t i=lower_idx; i<upper_idx; ++i) {
+                db.assign( datasets[i].points, datasets[i].points + datasets[i].size);
+                ordering.clear();
+
+                if( params.eps == OPTICS::UNDEFINED) {
+                    ordering = optics_unbounded( db, params.min_pts, nullptr, pool);
+                } else {
+                    ordering.reserve( db.size());
+                    for( auto p_it = db.begin(); p_it != db.end(); ++p_it) {
+                        if( !(*p_it)->is_processed())
+                            expand_cluster_order( db, *p_it, params.eps, params.min_pts, ordering, ws);
+                    }
+                }
+                std::copy( ordering.begin(), ordering.end(), ret.ordering.begin() + ret.offsets[i]);
+            }
+        });
+        return ret;
+    }
+
+} // END namespace OPTICS
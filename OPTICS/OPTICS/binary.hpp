@@ -0,0 +1,392 @@
+/******************************************************************************
+/* @file Contains a store of bit-packed binary codes, Hamming distance kernels
+/*       and a multi-index hashing index for range queries over the codes.
+/*
+/*
+/* @author langenhagen
+/* @version 261016
+/******************************************************************************/
+#pragma once
+
+///////////////////////////////////////////////////////////////////////////////
+// INCLUDES project headers
+
+#include "DataPoint.hpp"
+
+///////////////////////////////////////////////////////////////////////////////
+//INCLUDES C/C++ standard library (and other external libraries)
+
+#include <algorithm> // sort, lower_bound, min, max
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#if defined(_MSC_VER) && defined(_M_X64)
+#include <intrin.h>
+#define OPTICS_HAS_POPCNT_KERNEL
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define OPTICS_HAS_POPCNT_KERNEL
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+// NAMESPACE, CONSTANTS and TYPE DECLARATIONS/IMPLEMENTATIONS
+
+namespace OPTICS {
+
+    /// A function that computes the Hamming distance between two codes of n_words 64-bit words.
+    typedef std::uint32_t (*HammingKernel)( const std::uint64_t* a, const std::uint64_t* b, const std::size_t n_words);
+
+
+
+    /** Implements a store of binary codes, e.g. perceptual hashes, packed into 64-bit words.
+     * Bit i of a code is bit i%64 of its word i/64, with one point per code.
+     * Run OPTICS on the points with optics_indexed() and a BinaryIndex.
+     */
+    class BinaryStore : public StatePoints {
+
+    private: // vars
+
+        std::uint32_t _bits;                ///< The number of bits of a code.
+        std::size_t _n_words;               ///< The number of 64-bit words of a code.
+        std::vector<std::uint64_t> _codes;  ///< The codes, _n_words words per code.
+
+    public: // ctor & dtor
+
+        /** Main constructor.
+         * @param codes The packed codes, ceil(bits/64) words per code. Bits beyond the code length are ignored.
+         * @param n The number of codes, i.e. points.
+         * @param bits The number of bits of a code. Must be greater than 0.
+         */
+        BinaryStore( const std::uint64_t* codes, const std::size_t n, const std::uint32_t bits)
+            : StatePoints( n), _bits( bits), _n_words( (bits + 63) / 64), _codes( codes, codes + n*_n_words) {
+            assert( bits > 0 && "Codes must have at least one bit");
+            if( bits % 64 != 0) {
+                const std::uint64_t mask = (std::uint64_t(1) << (bits % 64)) - 1;
+                for( std::size_t i=0; i<n; ++i)
+                    _codes[i*_n_words + _n_words-1] &= mask;
+            }
+        }
+
+    public: // methods
+
+        /** Retrieves the number of bits of a code.
+         * @return The number of bits.
+         */
+        inline std::uint32_t bits() const { return _bits; }
+
+        /** Retrieves the number of 64-bit words of a code.
+         * @return The number of words.
+         */
+        inline std::size_t n_words() const { return _n_words; }
+
+        /** Retrieves the code of a point.
+         * @param idx The index of the point.
+         * @return A pointer to n_words() words.
+         */
+        inline const std::uint64_t* code( const std::size_t idx) const { return _codes.data() + idx*_n_words; }
+
+        /** Retrieves a range of up to 32 bits of a code.
+         * @param idx The index of the point.
+         * @param first The first bit of the range.
+         * @param length The number of bits of the range, at most 32.
+         * @return The bits of the range, with bit first as the lowest bit.
+         */
+        inline std::uint32_t substring( const std::size_t idx, const std::uint32_t first, const std::uint32_t length) const {
+            assert( length <= 32 && first + length <= _bits && "The range must be within the code and at most 32 bits long.");
+            const std::uint64_t* c = code( idx);
+            const std::uint32_t offset = first % 64;
+            std::uint64_t ret = c[first / 64] >> offset;
+            if( offset + length > 64)
+                ret |= c[first / 64 + 1] << (64 - offset);
+            return static_cast<std::uint32_t>( ret & ((std::uint64_t(1) << length) - 1));
+        }
+    };
+
+
+
+    // FUNCTION DECLARATIONS ######################################################################
+
+    std::uint32_t hamming_distance( const std::uint64_t* a, const std::uint64_t* b, const std::size_t n_words);
+    HammingKernel hamming_kernel();
+    std::uint32_t hamming_distance_portable( const std::uint64_t* a, const std::uint64_t* b, const std::size_t n_words);
+#ifdef OPTICS_HAS_POPCNT_KERNEL
+    std::uint32_t hamming_distance_popcnt( const std::uint64_t* a, const std::uint64_t* b, const std::size_t n_words);
+#endif
+
+
+
+    // KERNELS ####################################################################################
+
+
+    /** Computes the Hamming distance between two codes with the fastest kernel of the running CPU.
+     * Prefer calling hamming_kernel() once and the returned kernel in loops.
+     * @param a The first code.
+     * @param b The second code.
+     * @param n_words The number of 64-bit words of both codes.
+     * @return The number of differing bits.
+     */
+    std::uint32_t hamming_distance( const std::uint64_t* a, const std::uint64_t* b, const std::size_t n_words) {
+        return hamming_kernel()( a, b, n_words);
+    }
+
+
+    /** Selects the fastest Hamming distance kernel for the running CPU.
+     * The choice is made once, on the first call: the kernel with the hardware POPCNT instruction if
+     * the compiler can emit it and the CPU supports it, the portable kernel otherwise.
+     * @return The kernel.
+     */
+    HammingKernel hamming_kernel() {
+        struct Selector {
+            static HammingKernel select() {
+#if defined(OPTICS_HAS_POPCNT_KERNEL) && defined(_MSC_VER)
+                int info[4];
+                __cpuid( info, 1);
+                if( (info[2] >> 23) & 1)
+                    return &hamming_distance_popcnt;
+#elif defined(OPTICS_HAS_POPCNT_KERNEL)
+                if( __builtin_cpu_supports( "popcnt"))
+                    return &hamming_distance_popcnt;
+#endif
+                return &hamming_distance_portable;
+            }
+        };
+        static const HammingKernel kernel = Selector::select();
+        return kernel;
+    }
+
+
+    /** Computes the Hamming distance between two codes with a SWAR population count,
+     * which runs on every CPU.
+     * @param a The first code.
+     * @param b The second code.
+     * @param n_words The number of 64-bit words of both codes.
+     * @return The number of differing bits.
+     */
+    std::uint32_t hamming_distance_portable( const std::uint64_t* a, const std::uint64_t* b, const std::size_t n_words) {
+        std::uint32_t ret = 0;
+        for( std::size_t i=0; i<n_words; ++i) {
+            std::uint64_t x = a[i] ^ b[i];
+            x = x - ((x >> 1) & 0x5555555555555555ull);
+            x = (x & 0x3333333333333333ull) + ((x >> 2) & 0x3333333333333333ull);
+            x = (x + (x >> 4)) & 0x0f0f0f0f0f0f0f0full;
+            ret += static_cast<std::uint32_t>( (x * 0x0101010101010101ull) >> 56);
+        }
+        return ret;
+    }
+
+
+#ifdef OPTICS_HAS_POPCNT_KERNEL
+    /** Computes the Hamming distance between two codes with the hardware POPCNT instruction.
+     * Four independent accumulators hide the latency of the instruction.
+     * Must only be called if the CPU supports POPCNT; see hamming_kernel().
+     * @param a The first code.
+     * @param b The second code.
+     * @param n_words The number of 64-bit words of both codes.
+     * @return The number of differing bits.
+     */
+#if !defined(_MSC_VER)
+    __attribute__((target("popcnt")))
+#endif
+    std::uint32_t hamming_distance_popcnt( const std::uint64_t* a, const std::uint64_t* b, const std::size_t n_words) {
+#ifdef _MSC_VER
+#define OPTICS_POPCNT64( x) static_cast<std::uint64_t>( __popcnt64( x))
+#else
+#define OPTICS_POPCNT64( x) static_cast<std::uint64_t>( __builtin_popcountll( x))
+#endif
+        std::uint64_t c0 = 0, c1 = 0, c2 = 0, c3 = 0;
+        std::size_t i = 0;
+        for( ; i+4<=n_words; i+=4) {
+            c0 += OPTICS_POPCNT64( a[i] ^ b[i]);
+            c1 += OPTICS_POPCNT64( a[i+1] ^ b[i+1]);
+            c2 += OPTICS_POPCNT64( a[i+2] ^ b[i+2]);
+            c3 += OPTICS_POPCNT64( a[i+3] ^ b[i+3]);
+        }
+        for( ; i<n_words; ++i)
+            c0 += OPTICS_POPCNT64( a[i] ^ b[i]);
+#undef OPTICS_POPCNT64
+        return static_cast<std::uint32_t>( c0 + c1 + c2 + c3);
+    }
+#endif
+
+
+
+    // INDEX ######################################################################################
+
+
+    /** Implements a multi-index hashing (MIH) index over the codes of a BinaryStore for range queries
+     * under the Hamming distance.
+     * Every code is split into m disjoint substrings, and table j maps the j-th substring to the codes
+     * that have it. By the pigeonhole principle, a code within distance r of the query differs from it
+     * in at most floor(r/m) bits in at least one substring. A query thus looks up, in every table, all
+     * substrings within that distance of the query's substring, and verifies the distinct candidates
+     * with the Hamming kernel. If the lookups would cost more than a scan, e.g. for a large radius,
+     * the query scans all codes instead.
+     * Hamming distances are integers; they are squared like all distances in the OPTICS module.
+     * The index keeps per-query scratch memory, so one index must not be queried concurrently.
+     */
+    class BinaryIndex {
+
+    private: // types
+
+        /// A hash table over one substring, as sorted distinct keys with the codes of every key.
+        struct Table {
+            std::uint32_t first;                ///< The first bit of the substring.
+            std::uint32_t length;               ///< The number of bits of the substring.
+            std::vector<std::uint32_t> keys;    ///< The distinct substrings, ascending.
+            std::vector<std::uint32_t> offsets; ///< The codes of keys[k] are ids[offsets[k], offsets[k+1]).
+            std::vector<std::uint32_t> ids;     ///< The indices of the codes, key after key.
+        };
+
+    private: // vars
+
+        BinaryStore& _store;                ///< The indexed codes.
+        HammingKernel _kernel;              ///< The Hamming distance kernel.
+        std::vector<Table> _tables;         ///< The tables, one per substring.
+        mutable std::vector<std::uint32_t> _candidates; ///< Scratch memory: the candidates of the current query.
+        mutable std::vector<bool> _is_candidate;    ///< Scratch memory: whether a code is a candidate of the current query.
+
+    public: // ctor & dtor
+
+        /** Main constructor. Builds the tables in O(m n log n).
+         * @param store The codes to index.
+         * @param n_tables The number m of substrings. 0 chooses substrings of about log2(n) bits,
+         *        which makes the expected number of codes per key about 1. Substrings have at most 32 bits.
+         */
+        explicit BinaryIndex( BinaryStore& store, unsigned int n_tables = 0)
+            : _store( store), _kernel( hamming_kernel()), _is_candidate( store.size(), false) {
+            const std::uint32_t bits = store.bits();
+            if( n_tables == 0) {
+                const double log_n = std::log( std::max( 2.0, static_cast<double>( store.size()))) / std::log( 2.0);
+                const std::uint32_t length = std::max( 1u, static_cast<std::uint32_t>( log_n + 0.5));
+                n_tables = (bits + length - 1) / length;
+            }
+            n_tables = std::max( std::min( n_tables, bits), (bits + 31) / 32);
+
+            std::vector<std::pair<std::uint32_t, std::uint32_t>> entries( store.size());
+            _tables.resize( n_tables);
+            for( unsigned int j=0; j<n_tables; ++j) {
+                Table& t = _tables[j];
+                t.first = static_cast<std::uint32_t>( std::uint64_t( bits) * j / n_tables);
+                t.length = static_cast<std::uint32_t>( std::uint64_t( bits) * (j+1) / n_tables) - t.first;
+
+                for( std::size_t i=0; i<store.size(); ++i)
+                    entries[i] = std::make_pair( store.substring( i, t.first, t.length), static_cast<std::uint32_t>( i));
+                std::sort( entries.begin(), entries.end());
+                t.ids.reserve( entries.size());
+                for( auto it=entries.begin(); it!=entries.end(); ++it) {
+                    if( t.keys.empty() || t.keys.back() != it->first) {
+                        t.keys.push_back( it->first);
+                        t.offsets.push_back( static_cast<std::uint32_t>( t.ids.size()));
+                    }
+                    t.ids.push_back( it->second);
+                }
+                t.offsets.push_back( static_cast<std::uint32_t>( t.ids.size()));
+            }
+        }
+
+    private: // forbidden copy construction and assignment
+
+        BinaryIndex( const BinaryIndex&);
+        BinaryIndex& operator=( const BinaryIndex&);
+
+    public: // methods
+
+        /** Retrieves all indexed codes within a given Hamming distance of a query code.
+         * @param p The query point. Must be a point of the indexed store.
+         * @param eps The radius of the query in bits.
+         * @param o_N_eps Receives all points within the radius around p, including p itself,
+         *        together with their squared Hamming distances to p. The previous content is kept.
+         */
+        void range_query( const DataPoint* p, const real eps, Neighborhood& o_N_eps) const {
+            assert( eps >= 0 && "eps must not be negative");
+            const std::size_t a = _store.index_of( p);
+            const std::uint64_t* code_a = _store.code( a);
+            DataVector& points = _store.points();
+
+            if( eps >= _store.bits() || lookup_cost( static_cast<std::uint32_t>( eps)) >= _store.size()) {
+                for( std::size_t b=0; b<_store.size(); ++b)
+                    check( code_a, b, eps, points, o_N_eps);
+                return;
+            }
+
+            // probe every table with all substrings within radius / m of the query's substring
+            const std::uint32_t radius = static_cast<std::uint32_t>( eps) / static_cast<std::uint32_t>( _tables.size());
+            _candidates.clear();
+            for( auto t=_tables.begin(); t!=_tables.end(); ++t) {
+                const std::uint32_t key = _store.substring( a, t->first, t->length);
+                for( std::uint32_t k=0; k<=std::min( radius, t->length); ++k) {
+                    // *** Gosper's hack enumerates all masks with k of length bits set ***
+                    const std::uint64_t end = std::uint64_t(1) << t->length;
+                    for( std::uint64_t mask = (std::uint64_t(1) << k) - 1; mask < end; ) {
+                        probe( *t, key ^ static_cast<std::uint32_t>( mask));
+                        if( mask == 0)
+                            break;
+                        const std::uint64_t low = mask & (0 - mask);
+                        const std::uint64_t ripple = mask + low;
+                        mask = ripple | (((mask ^ ripple) >> 2) / low);
+                    }
+                }
+            }
+
+            for( auto it=_candidates.begin(); it!=_candidates.end(); ++it) {
+                check( code_a, *it, eps, points, o_N_eps);
+                _is_candidate[*it] = false;
+            }
+        }
+
+    private: // helpers
+
+        /** Adds the codes of a key to the candidates of the current query.
+         * @param t The table.
+         * @param key The substring to look up.
+         */
+        inline void probe( const Table& t, const std::uint32_t key) const {
+            auto key_it = std::lower_bound( t.keys.begin(), t.keys.end(), key);
+            if( key_it == t.keys.end() || *key_it != key)
+                return;
+            const std::size_t k = key_it - t.keys.begin();
+            for( std::uint32_t i=t.offsets[k]; i<t.offsets[k+1]; ++i) {
+                if( !_is_candidate[t.ids[i]]) {
+                    _is_candidate[t.ids[i]] = true;
+                    _candidates.push_back( t.ids[i]);
+                }
+            }
+        }
+
+        /** Adds a code to a neighborhood if it is within the query radius.
+         * @param code_a The code of the query point.
+         * @param b The index of the code.
+         * @param eps The radius of the query.
+         * @param points The points of the store.
+         * @param o_N_eps The neighborhood to extend.
+         */
+        inline void check( const std::uint64_t* code_a, const std::size_t b, const real eps, const DataVector& points, Neighborhood& o_N_eps) const {
+            const std::uint32_t d = _kernel( code_a, _store.code( b), _store.n_words());
+            if( d <= eps) {
+                Neighbor n = { points[b], static_cast<real>( d*d) };
+                o_N_eps.push_back( n);
+            }
+        }
+
+        /** Estimates the cost of the table lookups of a query in units of a Hamming distance computation:
+         * the number of substrings within distance radius / m of a substring, summed over all tables,
+         * times the cost of a binary search.
+         * @param radius The radius of the query in bits.
+         * @return The cost of the lookups, saturated at the number of codes.
+         */
+        double lookup_cost( const std::uint32_t radius) const {
+            const std::uint32_t r = radius / static_cast<std::uint32_t>( _tables.size());
+            const double search_cost = std::max( 1.0, std::log( static_cast<double>( _store.size()) + 1) / std::log( 2.0));
+            double ret = 0;
+            for( auto t=_tables.begin(); t!=_tables.end(); ++t) {
+                double binomial = 1;
+                for( std::uint32_t k=0; k<=std::min( r, t->length) && ret < _store.size(); ++k) {
+                    ret += binomial * search_cost;
+                    binomial = binomial * (t->length - k) / (k + 1);
+                }
+            }
+            return std::min( ret, static_cast<double>( _store.size()));
+        }
+    };
+
+} // END namespace OPTICS
@@ -0,0 +1,233 @@
+/******************************************************************************
+/* @file Contains the ClusterTree class that represents the hierarchical
+/*       cluster structure of an OPTICS reachability plot.
+/*
+/*
+/* @author langenhagen
+/* @version 261016
+/******************************************************************************/
+#pragma once
+
+///////////////////////////////////////////////////////////////////////////////
+// INCLUDES project headers
+
+#include "DataPoint.hpp"
+
+///////////////////////////////////////////////////////////////////////////////
+//INCLUDES C/C++ standard library (and other external libraries)
+
+#include <algorithm> // sort
+#include <queue>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+// NAMESPACE, CONSTANTS and TYPE DECLARATIONS/IMPLEMENTATIONS
+
+namespace OPTICS {
+
+    /// A node of a ClusterTree. Covers a contiguous range of an OPTICS ordering.
+    struct ClusterNode {
+        unsigned int begin; ///< The index of the first point of the node in the OPTICS ordering.
+        unsigned int end;   ///< The index behind the last point of the node in the OPTICS ordering.
+        real level;         ///< The reachability distance at which the node splits into its children. 0 for leaves.
+        int parent;         ///< The index of the parent node, or -1 for the root.
+        int left;           ///< The index of the left child node, or -1 for leaves.
+        int right;          ///< The index of the right child node, or -1 for leaves.
+
+        /// Retrieves the number of points covered by the node.
+        inline unsigned int size() const { return end - begin; }
+
+        /// Retrieves whether the node is a leaf, i.e. a single point.
+        inline bool is_leaf() const { return left < 0; }
+    };
+
+
+    /** Implements the full cluster hierarchy (dendrogram) of an OPTICS reachability plot.
+     * Every node covers a contiguous range of the ordering and splits at the highest reachability
+     * distance inside it into a left and a right child. The tree is built in O(n) as a Cartesian tree
+     * over the reachability distances and is stored as a flat array of 2n-1 nodes in preorder,
+     * so that the nodes of each subtree are contiguous. Cuts at any level can then be answered
+     * without revisiting the OPTICS ordering.
+     */
+    class ClusterTree {
+
+    private: // vars
+
+        std::vector<ClusterNode> _nodes; ///< The nodes in preorder. The root is the first node.
+
+    public: // ctor & dtor
+
+        /// Default constructor. Creates an empty tree.
+        ClusterTree()
+        {}
+
+        /** Main constructor.
+         * Builds the tree from the reachability distances of an OPTICS ordering.
+         * @param reachabilities The OPTICS ordered reachability distances.
+         */
+        explicit ClusterTree( const std::vector<real>& reachabilities) {
+            build( reachabilities);
+        }
+
+        /** Convenience constructor.
+         * Builds the tree from an OPTICS ordering.
+         * @param result The OPTICS ordered result vector of the optics function.
+         * @see optics()
+         */
+        explicit ClusterTree( const DataVector& result) {
+            std::vector<real> reachabilities;
+            reachabilities.reserve( result.size());
+            for( auto it=result.begin(); it!=result.end(); ++it)
+                reachabilities.push_back( (*it)->reachability_distance());
+            build( reachabilities);
+        }
+
+    public: // methods
+
+        /** (Re)builds the tree from the reachability distances of an OPTICS ordering in O(n).
+         * @param reachabilities The OPTICS ordered reachability distances.
+         *        The reachability distance of the first point is ignored.
+         */
+        void build( const std::vector<real>& reachabilities) {
+            const int n = static_cast<int>(reachabilities.size());
+            _nodes.clear();
+            if( n == 0)
+                return;
+            _nodes.reserve( 2*n - 1);
+
+            // build the Cartesian tree over the split positions 1..n-1 with a stack
+            std::vector<int> left_split( n, -1);
+            std::vector<int> right_split( n, -1);
+            std::vector<int> stack;
+            for( int s=1; s<n; ++s) {
+                int last = -1;
+                while( !stack.empty() && reachabilities[stack.back()] < reachabilities[s]) {
+                    last = stack.back();
+                    stack.pop_back();
+                }
+                left_split[s] = last;
+                if( !stack.empty())
+                    right_split[stack.back()] = s;
+                stack.push_back( s);
+            }
+
+            // emit the nodes in preorder; a split of -1 denotes a leaf
+            struct Task { int split; unsigned int begin; unsigned int end; int parent; bool is_left; };
+            std::vector<Task> tasks;
+            Task root = { stack.empty() ? -1 : stack.front(), 0, static_cast<unsigned int>(n), -1, false };
+            tasks.push_back( root);
+
+            while( !tasks.empty()) {
+                const Task t = tasks.back();
+                tasks.pop_back();
+
+                const int idx = static_cast<int>(_nodes.size());
+                ClusterNode node;
+                node.begin = t.begin;
+                node.end = t.end;
+                node.level = t.split < 0 ? 0 : reachabilities[t.split];
+                node.parent = t.parent;
+                node.left = -1;
+                node.right = -1;
+                _nodes.push_back( node);
+
+                if( t.parent >= 0) {
+                    if( t.is_left)
+                        _nodes[t.parent].left = idx;
+                    else
+                        _nodes[t.parent].right = idx;
+                }
+
+                if( t.split >= 0) {
+                    const unsigned int s = static_cast<unsigned int>(t.split);
+                    Task right = { right_split[s], s, t.end, idx, false };
+                    Task left = { left_split[s], t.begin, s, idx, true };
+                    tasks.push_back( right);
+                    tasks.push_back( left);
+                }
+            }
+        }
+
+        /** Retrieves all nodes.
+         * @return The nodes in preorder. The root is the first node.
+         */
+        inline const std::vector<ClusterNode>& nodes() const { return _nodes; }
+
+        /** Retrieves the node at a given index.
+         * @param idx The index of the node. Must be within the range of nodes().
+         * @return The node at the given index.
+         */
+        inline const ClusterNode& node( const std::size_t idx) const {
+            assert( idx < _nodes.size() && "Index must be within OPTICS::ClusterTree::_nodes' range.");
+            return _nodes[idx];
+        }
+
+        /** Cuts the tree horizontally at a given reachability distance.
+         * Only the nodes above the cut are visited.
+         * @param threshold The reachability distance at which to cut.
+         *        Nodes with a split level not greater than the threshold are not split any further.
+         * @param min_size The minimum number of points a cluster must consist of.
+         *        Points of smaller subtrees are not covered by any returned span and can be considered noise.
+         * @return The clusters as spans over the OPTICS ordering, in ascending order.
+         */
+        std::vector<ClusterSpan> cut( const real threshold, const unsigned int min_size = 1) const {
+            std::vector<ClusterSpan> ret;
+            if( _nodes.empty())
+                return ret;
+
+            std::vector<int> stack( 1, 0);
+            while( !stack.empty()) {
+                const ClusterNode& node = _nodes[stack.back()];
+                stack.pop_back();
+
+                if( node.size() < min_size)
+                    continue;
+
+                if( node.is_leaf() || node.level <= threshold) {
+                    ClusterSpan span = { node.begin, node.end };
+                    ret.push_back( span);
+                } else {
+                    stack.push_back( node.right);
+                    stack.push_back( node.left);
+                }
+            }
+            return ret;
+        }
+
+        /** Cuts the tree into a given number of clusters by repeatedly splitting
+         * the cluster with the highest split level in O(k log k).
+         * @param n_clusters The number of clusters to retrieve.
+         *        If the tree has less leaves, all leaves are returned.
+         * @return The clusters as spans over the OPTICS ordering, in ascending order.
+         */
+        std::vector<ClusterSpan> cut_into( const unsigned int n_clusters) const {
+            std::vector<ClusterSpan> ret;
+            if( _nodes.empty() || n_clusters == 0)
+                return ret;
+
+            // leaves come last among nodes of the same level, so that they are only popped when no node can be split anymore
+            auto lower_level = [this]( int a, int b) {
+                return _nodes[a].level < _nodes[b].level || (_nodes[a].level == _nodes[b].level && _nodes[a].is_leaf() && !_nodes[b].is_leaf());
+            };
+            std::priority_queue<int, std::vector<int>, decltype(lower_level)> clusters( lower_level);
+            clusters.push( 0);
+
+            while( clusters.size() < n_clusters && !_nodes[clusters.top()].is_leaf()) {
+                const ClusterNode& node = _nodes[clusters.top()];
+                clusters.pop();
+                clusters.push( node.left);
+                clusters.push( node.right);
+            }
+
+            while( !clusters.empty()) {
+                const ClusterNode& node = _nodes[clusters.top()];
+                clusters.pop();
+                ClusterSpan span = { node.begin, node.end };
+                ret.push_back( span);
+            }
+            std::sort( ret.begin(), ret.end(), []( const ClusterSpan& a, const ClusterSpan& b) { return a.begin < b.begin; });
+            return ret;
+        }
+    };
+
+} // END namespace OPTICS
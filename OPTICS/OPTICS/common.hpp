@@ -3,17 +3,25 @@
 /*
 /*
 /* @author langenhagen
-/* @version 150515
+/* @version 261016
 /******************************************************************************/
 #pragma once
 
 ///////////////////////////////////////////////////////////////////////////////
 //INCLUDES C/C++ standard library (and other external libraries)
 
+#include <cstddef>
 #include <limits>
+#include <memory>
+#include <new>
 #include <set>
+#include <type_traits>
 #include <vector>
 
+#ifdef OPTICS_USE_PMR
+#include <memory_resource>
+#endif
+
 ///////////////////////////////////////////////////////////////////////////////
 // NAMESPACE, CONSTANTS and TYPE DECLARATIONS/IMPLEMENTATIONS
 
@@ -27,6 +35,154 @@ namespace OPTICS {
     /// "Undefined" value for distance measures (which are always >= 0 by nature).
     const real UNDEFINED = std::numeric_limits<real>::max();
 
+    /// Cluster label of points that do not belong to any cluster.
+    const int NOISE = -1;
+
+#ifdef OPTICS_USE_PMR
+
+    /// The monotonic arena that Allocator<T>::type can be constructed from.
+    typedef std::pmr::monotonic_buffer_resource MonotonicArena;
+
+#else
+
+    /** Implements a monotonic arena: memory is handed out by bumping a pointer through large blocks
+     * and is only released when the arena is destroyed, all at once.
+     * This is the C++11 counterpart of std::pmr::monotonic_buffer_resource.
+     */
+    class MonotonicArena {
+
+    private: // vars
+
+        std::vector<char*> _blocks; ///< The blocks, all allocated with operator new.
+        char* _cur;                 ///< The first free byte of the current block.
+        std::size_t _left;          ///< The number of free bytes in the current block.
+        std::size_t _next_size;     ///< The size of the next block.
+
+    public: // ctor & dtor
+
+        /** Main constructor. Allocates nothing yet.
+         * @param initial_size The size of the first block in bytes. Following blocks double in size.
+         */
+        explicit MonotonicArena( const std::size_t initial_size = 1024) : _cur( nullptr), _left( 0), _next_size( initial_size > 0 ? initial_size : 1)
+        {}
+
+        /// Destructor. Releases all blocks.
+        ~MonotonicArena() {
+            for( auto it=_blocks.begin(); it!=_blocks.end(); ++it)
+                ::operator delete( *it);
+        }
+
+    private: // forbidden copy construction and assignment
+
+        MonotonicArena( const MonotonicArena&);
+        MonotonicArena& operator=( const MonotonicArena&);
+
+    public: // methods
+
+        /** Allocates memory from the arena.
+         * @param bytes The number of bytes.
+         * @param alignment The alignment, a power of 2 not greater than that of operator new.
+         * @return A pointer to the memory. Valid until the arena is destroyed.
+         */
+        void* allocate( const std::size_t bytes, const std::size_t alignment) {
+            std::size_t pad = (alignment - reinterpret_cast<std::size_t>(_cur) % alignment) % alignment;
+            if( pad + bytes > _left) {
+                while( _next_size < bytes)
+                    _next_size *= 2;
+                _cur = static_cast<char*>(::operator new( _next_size));
+                _blocks.push_back( _cur);
+                _left = _next_size;
+                _next_size *= 2;
+                pad = 0;
+            }
+            void* ret = _cur + pad;
+            _cur += pad + bytes;
+            _left -= pad + bytes;
+            return ret;
+        }
+    };
+
+    /** Implements a stateful allocator that takes its memory from a MonotonicArena, or from operator new
+     * if it has none. Deallocating memory of an arena is a no-op; the arena releases it when destroyed.
+     * Copies of containers take their memory from operator new, so that they may outlive the arena.
+     */
+    template<typename T>
+    class ArenaAllocator {
+
+        template<typename U> friend class ArenaAllocator;
+
+    public: // types
+
+        typedef T value_type;
+
+    private: // vars
+
+        MonotonicArena* _arena; ///< The arena, or nullptr for operator new.
+
+    public: // ctor & dtor
+
+        /** Main constructor.
+         * @param arena The arena, or nullptr for operator new.
+         */
+        ArenaAllocator( MonotonicArena* arena = nullptr) : _arena( arena)
+        {}
+
+        /// Converting constructor. Takes the arena of the given allocator.
+        template<typename U>
+        ArenaAllocator( const ArenaAllocator<U>& other) : _arena( other._arena)
+        {}
+
+    public: // methods
+
+        /** Allocates memory for n objects.
+         * @param n The number of objects.
+         * @return A pointer to the memory.
+         */
+        inline T* allocate( const std::size_t n) {
+            if( _arena)
+                return static_cast<T*>(_arena->allocate( n * sizeof(T), std::alignment_of<T>::value));
+            return static_cast<T*>(::operator new( n * sizeof(T)));
+        }
+
+        /** Deallocates memory for objects. A no-op if the memory is taken from an arena.
+         * @param p A pointer to the memory.
+         */
+        inline void deallocate( T* p, const std::size_t) {
+            if( !_arena)
+                ::operator delete( p);
+        }
+
+        /// Selects the allocator of a container copy: operator new.
+        inline ArenaAllocator select_on_container_copy_construction() const { return ArenaAllocator(); }
+
+        template<typename U>
+        inline bool operator==( const ArenaAllocator<U>& other) const { return _arena == other._arena; }
+
+        template<typename U>
+        inline bool operator!=( const ArenaAllocator<U>& other) const { return _arena != other._arena; }
+    };
+
+#endif
+
+    /** Selects the allocator of all OPTICS containers.
+     * By default, this is the ArenaAllocator, which behaves like the std::allocator unless it is
+     * constructed from a MonotonicArena. If OPTICS_USE_PMR is defined (requires C++17),
+     * this is the std::pmr::polymorphic_allocator, so that any std::pmr::memory_resource,
+     * e.g. a NUMA-local pool per thread, can be supplied as well.
+     * Either can be passed to the constructors of DataPoint, Workspace and the container typedefs below.
+     */
+    template<typename T>
+    struct Allocator {
+#ifdef OPTICS_USE_PMR
+        typedef std::pmr::polymorphic_allocator<T> type;
+#else
+        typedef ArenaAllocator<T> type;
+#endif
+    };
+
+    /// A vector of real values, e.g. the data elements of a DataPoint.
+    typedef std::vector<real, Allocator<real>::type> RealVector;
+
     /// The DataPoint class.
     class DataPoint;
     
@@ -38,9 +194,27 @@ namespace OPTICS {
     };
     
     /// A set of data points equipped with a Comp_DataPoint_Ptr_f comparison functor.
-    typedef std::set<DataPoint*, Comp_DataPoint_Ptr_f> DataSet;
+    typedef std::set<DataPoint*, Comp_DataPoint_Ptr_f, Allocator<DataPoint*>::type> DataSet;
 
     /// A vector of Pointers to DataPoints.
-    typedef std::vector<DataPoint*> DataVector;
+    typedef std::vector<DataPoint*, Allocator<DataPoint*>::type> DataVector;
+
+    /// A neighbor of a point, together with its squared distance to that point.
+    struct Neighbor {
+        DataPoint* point; ///< The neighboring point.
+        real distance;    ///< The squared distance to the neighboring point.
+    };
+
+    /// A vector of Neighbors, e.g. an epsilon-neighborhood.
+    typedef std::vector<Neighbor, Allocator<Neighbor>::type> Neighborhood;
+
+    /// A contiguous range [begin, end) of indices into an OPTICS ordered result vector.
+    struct ClusterSpan {
+        unsigned int begin; ///< The index of the first point of the span.
+        unsigned int end;   ///< The index behind the last point of the span.
+
+        /// Retrieves the number of points in the span.
+        inline unsigned int size() const { return end - begin; }
+    };
 
 } // END namespace OPTICS
\ No newline at end of file
@@ -0,0 +1,438 @@
+/******************************************************************************
+/* @file Contains a cover tree for range queries and a dual-tree all-k-nearest
+/*       neighbor search, which computes all core distances in one traversal.
+/*
+/*
+/* @author langenhagen
+/* @version 261016
+/******************************************************************************/
+#pragma once
+
+///////////////////////////////////////////////////////////////////////////////
+// INCLUDES project headers
+
+#include "optics.hpp"
+
+///////////////////////////////////////////////////////////////////////////////
+//INCLUDES C/C++ standard library (and other external libraries)
+
+#include <algorithm> // sort, push_heap, pop_heap, min, max
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+// NAMESPACE, CONSTANTS and TYPE DECLARATIONS/IMPLEMENTATIONS
+
+namespace OPTICS {
+
+    /** Implements a cover tree over a set of DataPoints.
+     * Every node is a point on a level i and covers its descendants within a radius of 2^i; the
+     * children of a node lie on lower levels. The number of children and the depth depend on the
+     * intrinsic dimension of the data rather than on the number of coordinates, which makes cover
+     * trees much faster than k-d trees on low-dimensional manifolds embedded in high dimensions.
+     * The tree is built by insertion (as a simplified cover tree, i.e. without the separation
+     * invariant) and then stored in the implicit form, in which a point with children has a leaf of
+     * its own as its first child. Every point is thus exactly one leaf, and the leaves of the children
+     * of a node partition the leaves of the node. Every node stores the maximum distance to the points
+     * of its leaves, which bounds all queries. The tree is static, i.e. points cannot be added later.
+     * The tree keeps per-traversal scratch memory, so one tree must not be used concurrently.
+     */
+    class CoverTree {
+
+    private: // types
+
+        /// A node of the tree. The children of a node are consecutive.
+        struct Node {
+            std::uint32_t point;        ///< The index of the point of the node.
+            std::uint32_t first_child;  ///< The index of the first child.
+            std::uint32_t n_children;   ///< The number of children. 0 for leaves.
+            double max_distance;        ///< The maximum distance from the point to the points of the leaves below the node.
+        };
+
+        /// A node on the stack of a traversal, with the squared and the plain distance of its point to another point.
+        struct Entry {
+            std::uint32_t node;
+            real squared_distance;
+            double distance;
+            inline bool operator<( const Entry& other) const { return distance < other.distance; }
+        };
+
+    private: // vars
+
+        unsigned int _dim;                  ///< The dimensionality of the points.
+        DataVector _points;                 ///< The indexed points, in the order of construction.
+        std::vector<real> _coords;          ///< The coordinates of the points, _dim values per point.
+        std::vector<Node> _nodes;           ///< The nodes. The root is the first node.
+        mutable std::vector<Entry> _stack;  ///< Scratch memory: the nodes to visit.
+        mutable std::vector<real> _heaps;   ///< Scratch memory of the all-k-NN search: per point a max-heap of the k smallest squared distances.
+        mutable std::vector<std::uint32_t> _heap_sizes; ///< Scratch memory of the all-k-NN search: the number of distances in every heap.
+        mutable std::vector<double> _bounds;///< Scratch memory of the all-k-NN search: per node, the largest k-th nearest neighbor distance of its points.
+
+    public: // ctor & dtor
+
+        /** Main constructor.
+         * Builds the tree over the given points.
+         * @param db The points to index. All points must have the same dimensionality.
+         */
+        explicit CoverTree( const DataVector& db)
+            : _dim( db.empty() ? 0 : static_cast<unsigned int>( db.front()->data().size())), _points( db.begin(), db.end()) {
+            _coords.reserve( db.size() * _dim);
+            for( auto p_it=db.begin(); p_it!=db.end(); ++p_it) {
+                assert( (*p_it)->data().size() == _dim && "All points must have the same dimensionality");
+                _coords.insert( _coords.end(), (*p_it)->data().begin(), (*p_it)->data().end());
+            }
+            if( !db.empty())
+                build();
+        }
+
+    private: // forbidden copy construction and assignment
+
+        CoverTree( const CoverTree&);
+        CoverTree& operator=( const CoverTree&);
+
+    public: // methods
+
+        /** Retrieves the number of indexed points.
+         * @return The number of points.
+         */
+        inline std::size_t size() const { return _points.size(); }
+
+        /** Retrieves all indexed points within a given distance of a point.
+         * @param p The query point. Must have the dimensionality of the indexed points.
+         * @param eps The radius of the query.
+         * @param o_N_eps Receives all points within the radius around p, including p itself if it is indexed,
+         *        together with their squared distances to p. The previous content is kept.
+         */
+        void range_query( const DataPoint* p, const real eps, Neighborhood& o_N_eps) const {
+            assert( eps >= 0 && "eps must not be negative");
+            assert( p->data().size() == _dim && "Query point must have the dimensionality of the indexed points");
+            if( _nodes.empty())
+                return;
+            const real* q = p->data().data();
+            const real eps_sq = eps*eps;
+
+            _stack.assign( 1, entry( 0, q));
+            while( !_stack.empty()) {
+                const Entry e = _stack.back();
+                _stack.pop_back();
+                const Node& node = _nodes[e.node];
+
+                if( node.n_children == 0) {
+                    if( e.squared_distance <= eps_sq) {
+                        Neighbor n = { _points[node.point], e.squared_distance };
+                        o_N_eps.push_back( n);
+                    }
+                    continue;
+                }
+                for( std::uint32_t c=node.first_child; c<node.first_child+node.n_children; ++c) {
+                    const Entry child = _nodes[c].point == node.point ? with_node( e, c) : entry( c, q);
+                    if( !is_beyond( child.distance, _nodes[c].max_distance, eps))
+                        _stack.push_back( child);
+                }
+            }
+        }
+
+        /** Finds the k-th nearest neighbor distance of every indexed point, counting the point itself,
+         * with a dual-tree traversal: the tree is traversed against itself, and a pair of subtrees is
+         * pruned as a whole once it cannot improve the k-th nearest neighbor of any of the points below
+         * the first subtree. Neighboring points thus share the work of their queries.
+         * @param k The number of nearest neighbors. Must be greater than 0.
+         * @param o_distances Receives the squared k-th nearest neighbor distance of every point, in the order
+         *        of construction, or OPTICS::UNDEFINED if there are fewer than k points.
+         */
+        void all_kth_nearest_distances( const unsigned int k, std::vector<real>& o_distances) const {
+            assert( k > 0 && "k must be greater than 0");
+            const std::size_t n = _points.size();
+            o_distances.assign( n, OPTICS::UNDEFINED);
+            if( n == 0)
+                return;
+
+            _heaps.assign( n * k, 0);
+            _heap_sizes.assign( n, 0);
+            _bounds.assign( _nodes.size(), std::numeric_limits<double>::infinity());
+            _stack.clear();
+
+            const Entry root = entry( 0, &_coords[static_cast<std::size_t>( _nodes[0].point) * _dim]);
+            dual_traversal( 0, root, k);
+
+            for( std::size_t i=0; i<n; ++i) {
+                if( _heap_sizes[i] == k)
+                    o_distances[i] = _heaps[i*k];
+            }
+        }
+
+    private: // helpers
+
+        /** Builds the tree: inserts all points into a simplified cover tree and stores it in the implicit form.
+         */
+        void build() {
+            const std::size_t n = _points.size();
+            const int DUPLICATE = INT_MIN; // *** the level of a point that equals its parent ***
+
+            // the root covers all points
+            double max_distance = 0;
+            for( std::size_t i=1; i<n; ++i)
+                max_distance = std::max( max_distance, std::sqrt( static_cast<double>( distance( 0, point_coords( i)))));
+            int root_level = max_distance > 0 ? static_cast<int>( std::ceil( std::log( max_distance) / std::log( 2.0))) : 0;
+            while( std::ldexp( 1.0, root_level) < max_distance)
+                ++root_level;
+
+            std::vector<int> levels( n, 0);
+            std::vector<std::vector<std::uint32_t>> children( n);
+            levels[0] = root_level;
+
+            for( std::uint32_t i=1; i<n; ++i) {
+                const real* x = point_coords( i);
+                std::uint32_t current = 0;
+                double current_distance = std::sqrt( static_cast<double>( distance( 0, x)));
+
+                for( ;;) {
+                    // descend into the nearest child that covers the point
+                    std::uint32_t nearest = 0;
+                    double nearest_distance = std::numeric_limits<double>::infinity();
+                    for( auto c_it=children[current].begin(); c_it!=children[current].end(); ++c_it) {
+                        if( levels[*c_it] == DUPLICATE)
+                            continue;
+                        const double d = std::sqrt( static_cast<double>( distance( *c_it, x)));
+                        if( d <= std::ldexp( 1.0, levels[*c_it]) && d < nearest_distance) {
+                            nearest = *c_it;
+                            nearest_distance = d;
+                        }
+                    }
+                    if( nearest_distance == std::numeric_limits<double>::infinity())
+                        break;
+                    current = nearest;
+                    current_distance = nearest_distance;
+                }
+                levels[i] = current_distance == 0 ? DUPLICATE : levels[current] - 1;
+                children[current].push_back( i);
+            }
+
+            // store the tree in the implicit form, in breadth-first order, so that children are consecutive
+            const std::uint32_t SELF_LEAF = UINT32_MAX; // *** the first_child of the own leaf of a point, until it is visited ***
+            _nodes.reserve( 2*n);
+            Node root = { 0, 0, 0, 0.0 };
+            _nodes.push_back( root);
+            for( std::size_t idx=0; idx<_nodes.size(); ++idx) {
+                const std::uint32_t point = _nodes[idx].point;
+                if( _nodes[idx].first_child == SELF_LEAF || children[point].empty()) {
+                    _nodes[idx].first_child = 0;
+                    continue;
+                }
+
+                _nodes[idx].first_child = static_cast<std::uint32_t>( _nodes.size());
+                _nodes[idx].n_children = static_cast<std::uint32_t>( children[point].size() + 1);
+                Node self_leaf = { point, SELF_LEAF, 0, 0.0 };
+                _nodes.push_back( self_leaf);
+                for( auto c_it=children[point].begin(); c_it!=children[point].end(); ++c_it) {
+                    Node child = { *c_it, 0, 0, 0.0 };
+                    _nodes.push_back( child);
+                }
+            }
+
+            // the maximum distances, bottom-up: children come after their parents
+            for( std::size_t idx=_nodes.size(); idx-->0; ) {
+                Node& node = _nodes[idx];
+                double ret = 0;
+                for( std::uint32_t c=node.first_child; c<node.first_child+node.n_children; ++c) {
+                    const double d = _nodes[c].point == node.point ? 0.0 : std::sqrt( static_cast<double>( distance( node.point, point_coords( _nodes[c].point))));
+                    ret = std::max( ret, d + _nodes[c].max_distance);
+                }
+                node.max_distance = ret;
+            }
+        }
+
+        /** Runs the dual-tree all-k-NN search for a pair of nodes, i.e. for all pairs of leaves below them.
+         * @param query The node of the query points.
+         * @param reference The node of the reference points, with its distances to the point of the query node.
+         * @param k The number of nearest neighbors.
+         */
+        void dual_traversal( const std::uint32_t query, const Entry& reference, const unsigned int k) const {
+            const Node& q = _nodes[query];
+            const Node& r = _nodes[reference.node];
+            if( is_beyond( reference.distance, q.max_distance + r.max_distance, _bounds[query]))
+                return;
+
+            if( q.n_children == 0 && r.n_children == 0) {
+                // a pair of points
+                real* heap = &_heaps[static_cast<std::size_t>( q.point) * k];
+                std::uint32_t& size = _heap_sizes[q.point];
+                if( size < k) {
+                    heap[size++] = reference.squared_distance;
+                    std::push_heap( heap, heap + size);
+                } else if( reference.squared_distance < heap[0]) {
+                    std::pop_heap( heap, heap + k);
+                    heap[k-1] = reference.squared_distance;
+                    std::push_heap( heap, heap + k);
+                }
+                if( size == k)
+                    _bounds[query] = std::sqrt( static_cast<double>( heap[0]));
+                return;
+            }
+
+            if( r.n_children == 0 || (q.n_children > 0 && q.max_distance >= r.max_distance)) {
+                // split the query node
+                const real* x = &_coords[static_cast<std::size_t>( r.point) * _dim];
+                double bound = 0;
+                for( std::uint32_t c=q.first_child; c<q.first_child+q.n_children; ++c) {
+                    Entry child_reference = reference;
+                    if( _nodes[c].point != q.point) {
+                        child_reference.squared_distance = distance( _nodes[c].point, x);
+                        child_reference.distance = std::sqrt( static_cast<double>( child_reference.squared_distance));
+                    }
+                    dual_traversal( c, child_reference, k);
+                    bound = std::max( bound, _bounds[c]);
+                }
+                _bounds[query] = std::min( _bounds[query], bound);
+            } else {
+                // split the reference node, visiting the nearest children first
+                const real* x = &_coords[static_cast<std::size_t>( q.point) * _dim];
+                const std::size_t frame = _stack.size();
+                for( std::uint32_t c=r.first_child; c<r.first_child+r.n_children; ++c)
+                    _stack.push_back( _nodes[c].point == r.point ? with_node( reference, c) : entry( c, x));
+                std::sort( _stack.begin() + frame, _stack.end());
+                for( std::size_t i=frame; i<frame+r.n_children; ++i) {
+                    const Entry child = _stack[i];
+                    dual_traversal( query, child, k);
+                }
+                _stack.resize( frame);
+            }
+        }
+
+        /** Tests whether a subtree cannot hold points within a radius.
+         * Allows for the rounding of the squared distances, which are computed in single precision.
+         * @param distance The distance between the query and the point of the subtree.
+         * @param max_distance The maximum distance of the subtree, plus that of the query subtree, if any.
+         * @param radius The radius.
+         * @return true if all points below are beyond the radius, false otherwise.
+         */
+        static inline bool is_beyond( const double distance, const double max_distance, const double radius) {
+            return distance - max_distance - radius > 1e-4 * (distance + max_distance + radius);
+        }
+
+        /** Creates a stack entry for a node.
+         * @param node The node.
+         * @param x The coordinates of the other point.
+         * @return The entry with the distances between the point of the node and the other point.
+         */
+        inline Entry entry( const std::uint32_t node, const real* x) const {
+            Entry ret;
+            ret.node = node;
+            ret.squared_distance = distance( _nodes[node].point, x);
+            ret.distance = std::sqrt( static_cast<double>( ret.squared_distance));
+            return ret;
+        }
+
+        /** Creates a stack entry for a node with the same point as another entry.
+         * @param e The other entry.
+         * @param node The node.
+         * @return The entry.
+         */
+        static inline Entry with_node( const Entry& e, const std::uint32_t node) {
+            Entry ret = e;
+            ret.node = node;
+            return ret;
+        }
+
+        /** Retrieves the coordinates of a point.
+         * @param point The index of the point.
+         * @return A pointer to the _dim coordinates.
+         */
+        inline const real* point_coords( const std::size_t point) const {
+            return &_coords[point * _dim];
+        }
+
+        /** Computes the squared distance between a point and a position, exactly like squared_distance().
+         * @param point The index of the point.
+         * @param x The coordinates of the position.
+         * @return The squared euclidean distance.
+         */
+        inline real distance( const std::size_t point, const real* x) const {
+            const real* y = point_coords( point);
+            real ret = 0;
+            for( unsigned int k=0; k<_dim; ++k) {
+                const real diff = y[k] - x[k];
+                ret += diff*diff;
+            }
+            return ret;
+        }
+    };
+
+
+
+    // FUNCTION DECLARATIONS ######################################################################
+
+    DataVector optics_cover_tree( DataVector& db, const real eps, const unsigned int min_pts);
+
+
+
+    // COVER TREE VERSION #########################################################################
+
+
+    /** Performs the classic OPTICS algorithm with a cover tree.
+     * All core distances are computed up front, in one dual-tree all-k-nearest-neighbor traversal,
+     * instead of one query per point. The expansion then queries the epsilon-neighborhoods of the
+     * core points only, since points that are not core points never update the seeds.
+     * The result equals the result of optics().
+     * @param db All data points that are to be considered by the algorithm. Changes their values.
+     * @param eps The epsilon representing the radius of the epsilon-neighborhood.
+     *        If set to OPTICS::UNDEFINED, the work is delegated to optics_unbounded() on the calling thread.
+     * @param min_pts The minimum number of points to be found within an epsilon-neigborhood.
+     * @return Return the OPTICS ordered list of Data points with reachability-distances and core-distances set.
+     */
+    DataVector optics_cover_tree( DataVector& db, const real eps, const unsigned int min_pts) {
+        assert( eps >= 0 && "eps must not be negative");
+        assert( min_pts > 0 && "min_pts must be greater than 0");
+        if( eps == OPTICS::UNDEFINED)
+            return optics_unbounded( db, min_pts, nullptr, serial_pool());
+
+        const real eps_sq = eps*eps;
+        const CoverTree tree( db);
+        std::vector<real> core_distances;
+        tree.all_kth_nearest_distances( min_pts+1, core_distances);
+
+        DataVector ret( db.get_allocator());
+        ret.reserve( db.size());
+        Workspace ws;
+        Neighborhood& N_eps = ws.neighbors;
+        SeedHeap& seeds = ws.seeds;
+
+        for( std::size_t i=0; i<db.size(); ++i) {
+            if( !db[i]->is_processed())
+                db[i]->core_distance( core_distances[i] <= eps_sq ? core_distances[i] : OPTICS::UNDEFINED);
+        }
+
+        for( auto p_it = db.begin(); p_it != db.end(); ++p_it) {
+            DataPoint* p = *p_it;
+            if( p->is_processed())
+                continue;
+
+            p->reachability_distance( OPTICS::UNDEFINED);
+            p->processed( true);
+            ret.push_back( p);
+            if( p->core_distance() == OPTICS::UNDEFINED)
+                continue;
+
+            seeds.clear();
+            N_eps.clear();
+            tree.range_query( p, eps, N_eps);
+            update_seeds( N_eps, p->core_distance(), seeds);
+
+            while( DataPoint* q = seeds.pop()) {
+                q->processed( true);
+                ret.push_back( q);
+                if( q->core_distance() != OPTICS::UNDEFINED) {
+                    // *** q is a core-object ***
+                    N_eps.clear();
+                    tree.range_query( q, eps, N_eps);
+                    update_seeds( N_eps, q->core_distance(), seeds);
+                }
+            }
+        }
+        return ret;
+    }
+
+} // END namespace OPTICS
@@ -0,0 +1,405 @@
+/******************************************************************************
+/* @file Contains the collapsing of duplicate DataPoints into weighted unique
+/*       points and a weighted variant of the OPTICS algorithm that runs on them.
+/*
+/*
+/* @author langenhagen
+/* @version 261016
+/******************************************************************************/
+#pragma once
+
+///////////////////////////////////////////////////////////////////////////////
+// INCLUDES project headers
+
+#include "optics.hpp"
+#include "workspace.hpp"
+
+///////////////////////////////////////////////////////////////////////////////
+//INCLUDES C/C++ standard library (and other external libraries)
+
+#include <algorithm> // sort, push_heap, pop_heap
+#include <cstdint>
+#include <cstring>   // memcpy
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+// NAMESPACE, CONSTANTS and TYPE DECLARATIONS/IMPLEMENTATIONS
+
+namespace OPTICS {
+
+    /// A squared distance to a unique point, together with the multiplicity of that point.
+    struct WeightedDistance {
+        real distance;          ///< The squared distance.
+        unsigned int weight;    ///< The multiplicity of the point.
+    };
+
+
+    /** Implements the partition of a database into groups of points with identical coordinates.
+     * The coordinates of every point are hashed, and points with equal hashes are compared exactly.
+     * Every group is represented by its first point in database order; the other points of the
+     * group are its duplicates. The representatives are kept in database order.
+     */
+    class DuplicateGroups {
+
+    private: // vars
+
+        DataVector _representatives;            ///< The first point of every group, in database order.
+        std::vector<unsigned int> _weights;     ///< The number of points of every group.
+        std::vector<std::size_t> _offsets;      ///< The duplicates of group i are _duplicates[_offsets[i], _offsets[i+1]).
+        DataVector _duplicates;                 ///< The duplicates of all groups, group after group, in database order.
+
+    public: // ctor & dtor
+
+        /// Default constructor. Creates an empty partition.
+        DuplicateGroups()
+        {}
+
+        /** Main constructor.
+         * Partitions the given points in O(n log n).
+         * @param db The points. All points must have the same dimensionality.
+         */
+        explicit DuplicateGroups( const DataVector& db) {
+            build( db);
+        }
+
+    public: // methods
+
+        /** (Re)partitions the given points in O(n log n).
+         * @param db The points. All points must have the same dimensionality.
+         */
+        void build( const DataVector& db) {
+            const std::size_t n = db.size();
+            _representatives.clear();
+            _weights.clear();
+            _offsets.assign( 1, 0);
+            _duplicates.clear();
+
+            // sort by hash, so that equal points are adjacent
+            std::vector<std::pair<std::uint64_t, std::size_t>> hashes( n);
+            for( std::size_t i=0; i<n; ++i)
+                hashes[i] = std::make_pair( coordinate_hash( db[i]), i);
+            std::sort( hashes.begin(), hashes.end());
+
+            // within runs of equal hashes, assign every point to the group of the first equal point
+            std::vector<std::size_t> group_of( n); // by the index of the first point of the group
+            for( std::size_t begin=0; begin<n; ) {
+                std::size_t end = begin+1;
+                while( end<n && hashes[end].first == hashes[begin].first)
+                    ++end;
+
+                for( std::size_t i=begin; i<end; ++i) {
+                    const std::size_t idx = hashes[i].second;
+                    group_of[idx] = idx;
+                    for( std::size_t j=begin; j<i; ++j) {
+                        const std::size_t other = hashes[j].second;
+                        if( group_of[other] == other && db[other]->data() == db[idx]->data()) {
+                            group_of[idx] = other; // *** indices ascend within the run, other is the first ***
+                            break;
+                        }
+                    }
+                }
+                begin = end;
+            }
+
+            // number the groups in database order
+            std::vector<std::size_t> group_idx( n);
+            for( std::size_t i=0; i<n; ++i) {
+                if( group_of[i] == i) {
+                    group_idx[i] = _representatives.size();
+                    _representatives.push_back( db[i]);
+                    _weights.push_back( 0);
+                } else {
+                    group_idx[i] = group_idx[group_of[i]];
+                }
+                ++_weights[group_idx[i]];
+            }
+
+            // gather the duplicates group after group
+            _offsets.resize( _representatives.size() + 1, 0);
+            for( std::size_t g=0; g<_representatives.size(); ++g)
+                _offsets[g+1] = _offsets[g] + _weights[g] - 1;
+            _duplicates.resize( _offsets.back());
+            std::vector<std::size_t> fill( _offsets.begin(), _offsets.end()-1);
+            for( std::size_t i=0; i<n; ++i) {
+                if( group_of[i] != i)
+                    _duplicates[fill[group_idx[i]]++] = db[i];
+            }
+        }
+
+        /** Retrieves the number of groups, i.e. of unique points.
+         * @return The number of groups.
+         */
+        inline std::size_t size() const { return _representatives.size(); }
+
+        /** Retrieves the representatives of all groups, e.g. as the input of optics_weighted().
+         * @return A reference to the representatives in database order.
+         */
+        inline DataVector& representatives() { return _representatives; }
+
+        /** Retrieves the number of points of every group.
+         * @return The multiplicities of the representatives.
+         */
+        inline const std::vector<unsigned int>& weights() const { return _weights; }
+
+        /** Retrieves the duplicates of a group, i.e. the points of the group other than its representative.
+         * @param idx The index of the group.
+         * @return A pointer to the first duplicate. The group has weights()[idx]-1 duplicates.
+         */
+        inline DataPoint* const* duplicates( const std::size_t idx) const {
+            assert( idx < size() && "Index must be within the range of the groups.");
+            return _duplicates.data() + _offsets[idx];
+        }
+
+    private: // helpers
+
+        /** Computes the FNV-1a hash of the coordinates of a point.
+         * Negative zero is hashed like zero, since both compare equal.
+         * @param p The point.
+         * @return The hash of the coordinates.
+         */
+        static std::uint64_t coordinate_hash( const DataPoint* p) {
+            std::uint64_t ret = 14695981039346656037ull;
+            const RealVector& data = p->data();
+            for( auto it=data.begin(); it!=data.end(); ++it) {
+                const real value = *it == 0 ? real(0) : *it;
+                unsigned char bytes[sizeof( real)];
+                std::memcpy( bytes, &value, sizeof( real));
+                for( unsigned int b=0; b<sizeof( real); ++b) {
+                    ret ^= bytes[b];
+                    ret *= 1099511628211ull;
+                }
+            }
+            return ret;
+        }
+    };
+
+
+
+    // FUNCTION DECLARATIONS ######################################################################
+
+    DataVector optics_deduplicated( DataVector& db, const real eps, const unsigned int min_pts);
+    DataVector optics_weighted( DataVector& db, const std::vector<unsigned int>& weights, const real eps, const unsigned int min_pts);
+
+    // helpers
+    real get_weighted_neighbors( const DataPoint* p,
+                                 const real eps,
+                                 const unsigned int min_pts,
+                                 DataVector& db,
+                                 const std::vector<unsigned int>& weights,
+                                 Neighborhood& o_N_eps,
+                                 std::vector<WeightedDistance>& heap);
+
+
+
+    // DEDUPLICATED VERSION #######################################################################
+
+
+    /** Performs the OPTICS algorithm after collapsing points with identical coordinates.
+     * Only the representatives of the sets of identical points are compared with each other, weighted
+     * by the number of points they represent, so the distance computations shrink with the number of
+     * unique points. When a representative leaves the seeds, its duplicates enter the seeds with its
+     * reachability distance, and from then on every core point that reaches the representative updates
+     * its duplicates as well, just like optics() updates all identical points alike. A duplicate
+     * shares the neighborhood and the core distance of its representative, so visiting it needs no
+     * neighbor scan. The result equals the one of optics(), as long as the points lie in memory in
+     * database order, e.g. in a PointStore, since both break ties of reachability distances by address.
+     * On grid or quantized data, this can shrink the problem by an order of magnitude.
+     * @param db All data points that are to be considered by the algorithm. Changes their values.
+     * @param eps The epsilon representing the radius of the epsilon-neighborhood.
+     * @param min_pts The minimum number of points to be found within an epsilon-neigborhood.
+     * @return Return the OPTICS ordered list of all Data points with reachability-distances and core-distances set.
+     */
+    DataVector optics_deduplicated( DataVector& db, const real eps, const unsigned int min_pts) {
+        assert( eps >= 0 && "eps must not be negative");
+        assert( min_pts > 0 && "min_pts must be greater than 0");
+        DuplicateGroups groups( db);
+        DataVector& representatives = groups.representatives();
+        const std::vector<unsigned int>& weights = groups.weights();
+
+        std::unordered_map<const DataPoint*, std::size_t> group_of;
+        std::vector<unsigned int> n_pending( groups.size()); // the number of unvisited duplicates of every group
+        group_of.reserve( db.size());
+        for( std::size_t g=0; g<groups.size(); ++g) {
+            group_of[representatives[g]] = g;
+            for( unsigned int i=0; i+1<weights[g]; ++i)
+                group_of[groups.duplicates( g)[i]] = g;
+            n_pending[g] = weights[g] - 1;
+        }
+
+        DataVector ret( db.get_allocator());
+        ret.reserve( db.size());
+        Workspace ws;
+        Neighborhood& N_eps = ws.neighbors;
+        SeedHeap& seeds = ws.seeds;
+        std::vector<WeightedDistance> heap;
+
+        for( auto p_it = db.begin(); p_it != db.end(); ++p_it) {
+            DataPoint* q = *p_it;
+            if( q->is_processed())
+                continue;
+
+            q->reachability_distance( OPTICS::UNDEFINED);
+            seeds.clear();
+            do {
+                const std::size_t g = group_of[q];
+                q->processed( true);
+                ret.push_back( q);
+
+                if( q != representatives[g]) {
+                    // *** a duplicate of a visited representative, whose update of the seeds it would repeat ***
+                    q->core_distance( representatives[g]->core_distance());
+                    --n_pending[g];
+                    continue;
+                }
+
+                const real c_dist = get_weighted_neighbors( q, eps, min_pts, representatives, weights, N_eps, heap);
+                q->core_distance( c_dist);
+
+                // the duplicates got the same updates as q so far
+                DataPoint* const* duplicates = groups.duplicates( g);
+                for( unsigned int i=0; i+1<weights[g]; ++i) {
+                    duplicates[i]->reachability_distance( q->reachability_distance());
+                    if( q->reachability_distance() != OPTICS::UNDEFINED)
+                        seeds.push( duplicates[i]);
+                }
+
+                if( c_dist == OPTICS::UNDEFINED)
+                    continue;
+
+                // *** q is a core-object ***
+                // the unvisited duplicates of visited neighbors, including q, are seeds of their own
+                const std::size_t n_neighbors = N_eps.size();
+                for( std::size_t i=0; i<n_neighbors; ++i) {
+                    const Neighbor neighbor = N_eps[i];
+                    const std::size_t neighbor_g = group_of[neighbor.point];
+                    if( !neighbor.point->is_processed() || n_pending[neighbor_g] == 0)
+                        continue;
+                    DataPoint* const* neighbor_duplicates = groups.duplicates( neighbor_g);
+                    for( unsigned int k=0; k+1<weights[neighbor_g]; ++k) {
+                        Neighbor n = { neighbor_duplicates[k], neighbor.distance };
+                        N_eps.push_back( n);
+                    }
+                }
+                update_seeds( N_eps, c_dist, seeds);
+            } while( (q = seeds.pop()) != nullptr);
+        }
+        return ret;
+    }
+
+
+
+    // WEIGHTED VERSION ###########################################################################
+
+
+    /** Performs the OPTICS algorithm on weighted points.
+     * A point of weight w counts as w points towards min_pts: the core distance of a point is the
+     * smallest distance within which the weights of the neighbors, including the point itself, sum
+     * up to more than min_pts.
+     * @param db All data points that are to be considered by the algorithm. Changes their values.
+     * @param weights The weight of every point of db, in the same order. All weights must be greater than 0.
+     * @param eps The epsilon representing the radius of the epsilon-neighborhood.
+     * @param min_pts The minimum number of points to be found within an epsilon-neigborhood.
+     * @return Return the OPTICS ordered list of Data points with reachability-distances and core-distances set.
+     */
+    DataVector optics_weighted( DataVector& db, const std::vector<unsigned int>& weights, const real eps, const unsigned int min_pts) {
+        assert( eps >= 0 && "eps must not be negative");
+        assert( min_pts > 0 && "min_pts must be greater than 0");
+        assert( weights.size() == db.size() && "There must be one weight per point");
+        DataVector ret( db.get_allocator());
+        ret.reserve( db.size());
+        Workspace ws;
+        std::vector<WeightedDistance> heap;
+
+        for( auto p_it = db.begin(); p_it != db.end(); ++p_it) {
+            DataPoint* p = *p_it;
+
+            if( p->is_processed())
+                continue;
+
+            p->reachability_distance( OPTICS::UNDEFINED);
+            const real core_dist_p = get_weighted_neighbors( p, eps, min_pts, db, weights, ws.neighbors, heap);
+            p->core_distance( core_dist_p);
+            p->processed( true);
+            ret.push_back( p);
+
+            if( core_dist_p == OPTICS::UNDEFINED)
+                continue;
+
+            ws.seeds.clear();
+            update_seeds( ws.neighbors, core_dist_p, ws.seeds);
+
+            while( DataPoint* q = ws.seeds.pop()) {
+                const real core_dist_q = get_weighted_neighbors( q, eps, min_pts, db, weights, ws.neighbors, heap);
+                q->core_distance( core_dist_q);
+                q->processed( true);
+                ret.push_back( q);
+                if( core_dist_q != OPTICS::UNDEFINED) {
+                    // *** q is a core-object ***
+                    update_seeds( ws.neighbors, core_dist_q, ws.seeds);
+                }
+            }
+        }
+        return ret;
+    }
+
+
+    // HELPERS ####################################################################################
+
+
+    /** Retrieves the epsilon-neighborhood of a weighted point and its squared core distance in one pass.
+     * The core distance is found with a bounded max-heap that keeps the fewest closest neighbors whose
+     * weights sum up to more than min_pts.
+     * @param p The point to be examined.
+     * @param eps The epsilon representing the radius of the epsilon-neighborhood.
+     * @param min_pts The minimum number of points to be found within an epsilon-neigborhood.
+     * @param db All data points that are to be considered by the algorithm.
+     * @param weights The weight of every point of db, in the same order.
+     * @param o_N_eps Receives all points of db within the epsilon-neighborhood of p, including p itself,
+     *        together with their squared distances to p. The previous content is cleared.
+     * @param heap A scratch buffer for the bounded heap. Its content is overwritten.
+     * @return The squared core distance of p, or OPTICS::UNDEFINED if the weights within the
+     *         epsilon-neighborhood do not sum up to more than min_pts.
+     */
+    real get_weighted_neighbors( const DataPoint* p,
+                                 const real eps,
+                                 const unsigned int min_pts,
+                                 DataVector& db,
+                                 const std::vector<unsigned int>& weights,
+                                 Neighborhood& o_N_eps,
+                                 std::vector<WeightedDistance>& heap) {
+        o_N_eps.clear();
+        heap.clear(); // the closest neighbors that outweigh min_pts, farthest on top
+        auto farther = []( const WeightedDistance& a, const WeightedDistance& b) { return a.distance < b.distance; };
+        unsigned long long heap_weight = 0;
+
+        const real eps_sq = eps*eps;
+
+        for( std::size_t i=0; i<db.size(); ++i) {
+            DataPoint* q = db[i];
+            const real d = squared_distance( p, q);
+            if( d > eps_sq)
+                continue;
+
+            Neighbor n = { q, d };
+            o_N_eps.push_back( n);
+
+            if( heap_weight > min_pts && d >= heap.front().distance)
+                continue;
+
+            WeightedDistance wd = { d, weights[i] };
+            heap.push_back( wd);
+            std::push_heap( heap.begin(), heap.end(), farther);
+            heap_weight += weights[i];
+            while( heap_weight - heap.front().weight > min_pts) {
+                // *** the farthest neighbor is not needed to outweigh min_pts ***
+                heap_weight -= heap.front().weight;
+                std::pop_heap( heap.begin(), heap.end(), farther);
+                heap.pop_back();
+            }
+        }
+        return heap_weight > min_pts ? heap.front().distance : OPTICS::UNDEFINED;
+    }
+
+} // END namespace OPTICS
@@ -0,0 +1,236 @@
+/******************************************************************************
+/* @file Contains the dynamic time warping (DTW) distance between time series
+/*       and an index that prunes DTW computations with a cascade of lower bounds.
+/*
+/*
+/* @author langenhagen
+/* @version 261016
+/******************************************************************************/
+#pragma once
+
+///////////////////////////////////////////////////////////////////////////////
+// INCLUDES project headers
+
+#include "DataPoint.hpp"
+
+///////////////////////////////////////////////////////////////////////////////
+//INCLUDES C/C++ standard library (and other external libraries)
+
+#include <algorithm> // min, max
+#include <deque>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+// NAMESPACE, CONSTANTS and TYPE DECLARATIONS/IMPLEMENTATIONS
+
+namespace OPTICS {
+
+    // FUNCTION DECLARATIONS ######################################################################
+
+    real dtw_squared_distance( const real* a, const real* b, const std::size_t n, const unsigned int band, const real abandon_above, std::vector<real>& buffer);
+    void dtw_envelope( const real* x, const std::size_t n, const unsigned int band, real* o_lower, real* o_upper);
+    real lb_kim( const real* a, const real* b, const std::size_t n);
+    real lb_keogh( const real* a, const real* lower, const real* upper, const std::size_t n, const real abandon_above);
+
+
+
+    /** Implements an index over time series for range queries under the dynamic time warping distance.
+     * Every DataPoint is one series; all series must have the same length. The warping path is
+     * constrained to a Sakoe-Chiba band, and the cost of a path is the sum of the squared differences
+     * along it, so the distances are squared like everywhere in the OPTICS module.
+     * The lower and upper envelopes of every series within the band are precomputed. A query tests
+     * every series against a cascade of lower bounds, cheapest first, and computes the full DTW only
+     * for the candidates that pass all of them:
+     *  - LB_Kim: the first and the last elements, which are on every warping path;
+     *  - LB_Keogh of the query against the envelope of the candidate;
+     *  - LB_Keogh of the candidate against the envelope of the query;
+     *  - the DTW itself, abandoned as soon as a row of the cost matrix exceeds eps.
+     * Use it with optics_indexed(). The index keeps per-query scratch memory, so one index must not
+     * be queried concurrently.
+     */
+    class DTWIndex {
+
+    private: // vars
+
+        DataVector _db;                     ///< The indexed series.
+        std::size_t _length;                ///< The length of every series.
+        unsigned int _band;                 ///< The half width of the Sakoe-Chiba band.
+        std::vector<real> _lower;           ///< The lower envelopes of all series, _length values per series.
+        std::vector<real> _upper;           ///< The upper envelopes of all series, _length values per series.
+        mutable std::vector<real> _query_lower; ///< Scratch memory: the lower envelope of the current query.
+        mutable std::vector<real> _query_upper; ///< Scratch memory: the upper envelope of the current query.
+        mutable std::vector<real> _buffer;  ///< Scratch memory: the rows of the DTW cost matrix.
+
+    public: // ctor & dtor
+
+        /** Main constructor.
+         * Precomputes the envelopes of all series in O(n * length).
+         * @param db The series to index. All series must have the same length.
+         * @param band The half width of the Sakoe-Chiba band: element i of one series can only be
+         *        matched with the elements i-band to i+band of the other. 0 yields the euclidean distance.
+         */
+        DTWIndex( const DataVector& db, const unsigned int band)
+            : _db( db.begin(), db.end()), _length( db.empty() ? 0 : db.front()->data().size()), _band( band),
+              _lower( db.size() * _length), _upper( db.size() * _length), _query_lower( _length), _query_upper( _length) {
+            for( std::size_t i=0; i<_db.size(); ++i) {
+                assert( _db[i]->data().size() == _length && "All series must have the same length");
+                dtw_envelope( _db[i]->data().data(), _length, _band, &_lower[i*_length], &_upper[i*_length]);
+            }
+        }
+
+    public: // methods
+
+        /** Retrieves all indexed series within a given DTW distance of a query series.
+         * @param p The query series. Must have the length of the indexed series.
+         * @param eps The radius of the query.
+         * @param o_N_eps Receives all series within the radius around p, including p itself if it is
+         *        indexed, together with their squared DTW distances to p. The previous content is kept.
+         */
+        void range_query( const DataPoint* p, const real eps, Neighborhood& o_N_eps) const {
+            assert( eps >= 0 && "eps must not be negative");
+            assert( p->data().size() == _length && "The query must have the length of the indexed series");
+            const real eps_sq = eps*eps;
+            const real* a = p->data().data();
+            dtw_envelope( a, _length, _band, _query_lower.data(), _query_upper.data());
+
+            for( std::size_t i=0; i<_db.size(); ++i) {
+                const real* b = _db[i]->data().data();
+                if( lb_kim( a, b, _length) > eps_sq)
+                    continue;
+                if( lb_keogh( a, &_lower[i*_length], &_upper[i*_length], _length, eps_sq) > eps_sq)
+                    continue;
+                if( lb_keogh( b, _query_lower.data(), _query_upper.data(), _length, eps_sq) > eps_sq)
+                    continue;
+
+                const real d = dtw_squared_distance( a, b, _length, _band, eps_sq, _buffer);
+                if( d <= eps_sq) {
+                    Neighbor n = { _db[i], d };
+                    o_N_eps.push_back( n);
+                }
+            }
+        }
+    };
+
+
+
+    // FUNCTIONS ##################################################################################
+
+
+    /** Computes the squared dynamic time warping distance between two series of equal length,
+     * i.e. the minimum sum of squared differences along a warping path within a Sakoe-Chiba band.
+     * Takes O(n * band) time and O(n) memory.
+     * @param a The first series.
+     * @param b The second series.
+     * @param n The length of both series.
+     * @param band The half width of the Sakoe-Chiba band.
+     * @param abandon_above The computation is abandoned once the distance is known to exceed this value.
+     *        Pass OPTICS::UNDEFINED to always compute the exact distance.
+     * @param buffer A scratch buffer for two rows of the cost matrix. Its content is overwritten.
+     * @return The squared DTW distance, or OPTICS::UNDEFINED if it exceeds abandon_above.
+     */
+    real dtw_squared_distance( const real* a, const real* b, const std::size_t n, const unsigned int band, const real abandon_above, std::vector<real>& buffer) {
+        if( n == 0)
+            return 0;
+        buffer.assign( 2*(n+1), OPTICS::UNDEFINED);
+        real* prev = &buffer[0];
+        real* curr = &buffer[n+1];
+        prev[0] = 0; // column j+1 of a row holds the cost up to element j of b
+
+        for( std::size_t i=0; i<n; ++i) {
+            const std::size_t lo = i > band ? i - band : 0;
+            const std::size_t hi = std::min( n-1, i + band);
+            // *** only the band and the cell left of it are read; the band moves right by at most one column per row ***
+            curr[lo] = OPTICS::UNDEFINED;
+            real row_min = OPTICS::UNDEFINED;
+
+            for( std::size_t j=lo; j<=hi; ++j) {
+                const real best = std::min( prev[j], std::min( prev[j+1], curr[j]));
+                if( best == OPTICS::UNDEFINED) {
+                    curr[j+1] = OPTICS::UNDEFINED;
+                    continue;
+                }
+                const real diff = a[i] - b[j];
+                curr[j+1] = best + diff*diff;
+                row_min = std::min( row_min, curr[j+1]);
+            }
+            if( row_min > abandon_above)
+                return OPTICS::UNDEFINED;
+            std::swap( prev, curr);
+        }
+        return prev[n] > abandon_above ? OPTICS::UNDEFINED : prev[n];
+    }
+
+
+    /** Computes the lower and upper envelope of a series within a Sakoe-Chiba band, i.e. the running
+     * minimum and maximum over the windows [i-band, i+band], in O(n) with monotonic queues.
+     * @param x The series.
+     * @param n The length of the series.
+     * @param band The half width of the band.
+     * @param o_lower Receives the n values of the lower envelope.
+     * @param o_upper Receives the n values of the upper envelope.
+     */
+    void dtw_envelope( const real* x, const std::size_t n, const unsigned int band, real* o_lower, real* o_upper) {
+        std::deque<std::size_t> min_queue;
+        std::deque<std::size_t> max_queue;
+        std::size_t next = 0; // the next element to enter the window
+
+        for( std::size_t i=0; i<n; ++i) {
+            const std::size_t hi = std::min( n-1, i + band);
+            for( ; next<=hi; ++next) {
+                while( !min_queue.empty() && x[min_queue.back()] >= x[next])
+                    min_queue.pop_back();
+                min_queue.push_back( next);
+                while( !max_queue.empty() && x[max_queue.back()] <= x[next])
+                    max_queue.pop_back();
+                max_queue.push_back( next);
+            }
+            const std::size_t lo = i > band ? i - band : 0;
+            while( min_queue.front() < lo)
+                min_queue.pop_front();
+            while( max_queue.front() < lo)
+                max_queue.pop_front();
+            o_lower[i] = x[min_queue.front()];
+            o_upper[i] = x[max_queue.front()];
+        }
+    }
+
+
+    /** Computes the LB_Kim lower bound of the squared DTW distance in O(1):
+     * the first and the last elements of both series are matched on every warping path.
+     * @param a The first series.
+     * @param b The second series.
+     * @param n The length of both series.
+     * @return A lower bound of the squared DTW distance.
+     */
+    real lb_kim( const real* a, const real* b, const std::size_t n) {
+        if( n == 0)
+            return 0;
+        const real first = a[0] - b[0];
+        if( n == 1)
+            return first*first;
+        const real last = a[n-1] - b[n-1];
+        return first*first + last*last;
+    }
+
+
+    /** Computes the LB_Keogh lower bound of the squared DTW distance in O(n): every element of
+     * one series is matched with at least one element of the other series within the band,
+     * hence at least with a value between the envelopes.
+     * @param a The first series.
+     * @param lower The lower envelope of the second series.
+     * @param upper The upper envelope of the second series.
+     * @param n The length of both series.
+     * @param abandon_above The computation is abandoned once the bound exceeds this value.
+     * @return A lower bound of the squared DTW distance. If the bound exceeds abandon_above,
+     *         some value greater than abandon_above.
+     */
+    real lb_keogh( const real* a, const real* lower, const real* upper, const std::size_t n, const real abandon_above) {
+        real ret = 0;
+        for( std::size_t i=0; i<n && ret<=abandon_above; ++i) {
+            const real diff = a[i] > upper[i] ? a[i] - upper[i] : a[i] < lower[i] ? lower[i] - a[i] : 0;
+            ret += diff*diff;
+        }
+        return ret;
+    }
+
+} // END namespace OPTICS
@@ -0,0 +1,237 @@
+/******************************************************************************
+/* @file Contains the haversine distance between geographic coordinates and a
+/*       spatial index for range queries on the sphere.
+/*
+/*
+/* @author langenhagen
+/* @version 261016
+/******************************************************************************/
+#pragma once
+
+///////////////////////////////////////////////////////////////////////////////
+// INCLUDES project headers
+
+#include "DataPoint.hpp"
+
+///////////////////////////////////////////////////////////////////////////////
+//INCLUDES C/C++ standard library (and other external libraries)
+
+#include <algorithm> // sort, lower_bound, min
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+// NAMESPACE, CONSTANTS and TYPE DECLARATIONS/IMPLEMENTATIONS
+
+namespace OPTICS {
+
+    /// The mean radius of the earth in meters.
+    const double EARTH_RADIUS = 6371008.8;
+
+
+
+    // FUNCTION DECLARATIONS ######################################################################
+
+    double haversine_distance( const double lat_a, const double lon_a, const double lat_b, const double lon_b, const double radius = EARTH_RADIUS);
+
+
+
+    /** Implements an index over geographic coordinates for range queries under the haversine distance.
+     * Every DataPoint holds the latitude and the longitude of a location in degrees as its first two
+     * data elements. The locations are mapped to 3D coordinates on the unit sphere and bucketed in a
+     * uniform grid there. Unlike a grid on latitude and longitude, this has no seam at the antimeridian
+     * and no degenerate cells at the poles. The straight-line distance between points on the sphere
+     * grows monotonically with their great-circle distance, so a query searches the cells around the
+     * query point within the chord that corresponds to eps, filters the candidates by their chord
+     * length and computes the haversine distance only for the remaining ones.
+     * The distances are in the unit of the radius, i.e. in meters by default, and squared like
+     * everywhere in the OPTICS module. Use it with optics_indexed().
+     */
+    class GeoIndex {
+
+    private: // types
+
+        /// A cell of the grid, identified by its integer coordinates.
+        struct Cell {
+            int64_t x, y, z;
+            inline bool operator<( const Cell& other) const {
+                return x != other.x ? x < other.x : y != other.y ? y < other.y : z < other.z;
+            }
+            inline bool operator==( const Cell& other) const { return x == other.x && y == other.y && z == other.z; }
+        };
+
+    private: // vars
+
+        DataVector _db;                     ///< The indexed points, sorted by cell.
+        std::vector<double> _xyz;           ///< The coordinates of the sorted points on the unit sphere, 3 values per point.
+        std::vector<Cell> _cells;           ///< The distinct non-empty cells, sorted.
+        std::vector<std::size_t> _offsets;  ///< The first point of every cell in _db, plus the number of points at the end.
+        double _radius;                     ///< The radius of the sphere.
+        double _cell_size;                  ///< The edge length of the cells in 3D unit-sphere coordinates.
+
+    public: // ctor & dtor
+
+        /** Main constructor. Builds the grid in O(n log n).
+         * @param db The points to index, with latitude and longitude in degrees as their first two data elements.
+         * @param cell_size The edge length of the grid cells, given as a distance on the sphere.
+         *        Queries are fastest if this is the eps of the OPTICS run. Must be greater than 0.
+         * @param radius The radius of the sphere. Defines the unit of the distances.
+         */
+        GeoIndex( const DataVector& db, const real cell_size, const double radius = EARTH_RADIUS)
+            : _radius( radius), _cell_size( chord_of( cell_size)) {
+            assert( cell_size > 0 && "cell_size must be greater than 0");
+            const std::size_t n = db.size();
+
+            std::vector<double> xyz( 3*n);
+            std::vector<Cell> cells( n);
+            std::vector<std::size_t> order( n);
+            for( std::size_t i=0; i<n; ++i) {
+                assert( db[i]->data().size() >= 2 && "Points must hold latitude and longitude");
+                to_unit_sphere( db[i], &xyz[3*i]);
+                cells[i] = cell_of( &xyz[3*i]);
+                order[i] = i;
+            }
+            std::sort( order.begin(), order.end(), [&cells]( const std::size_t a, const std::size_t b) {
+                return cells[a] < cells[b] || ( cells[a] == cells[b] && a < b);
+            });
+
+            _db.reserve( n);
+            _xyz.reserve( 3*n);
+            for( std::size_t i=0; i<n; ++i) {
+                const std::size_t idx = order[i];
+                if( _cells.empty() || !( _cells.back() == cells[idx])) {
+                    _cells.push_back( cells[idx]);
+                    _offsets.push_back( i);
+                }
+                _db.push_back( db[idx]);
+                _xyz.insert( _xyz.end(), &xyz[3*idx], &xyz[3*idx] + 3);
+            }
+            _offsets.push_back( n);
+        }
+
+    public: // methods
+
+        /** Retrieves all indexed points within a given haversine distance of a point.
+         * @param p The query point, with latitude and longitude in degrees as its first two data elements.
+         * @param eps The radius of the query in the unit of the sphere's radius.
+         * @param o_N_eps Receives all points within the radius around p, including p itself if it is
+         *        indexed, together with their squared haversine distances to p. The previous content is kept.
+         */
+        void range_query( const DataPoint* p, const real eps, Neighborhood& o_N_eps) const {
+            assert( eps >= 0 && "eps must not be negative");
+            double q[3];
+            to_unit_sphere( p, q);
+            // *** widen the chord filter a little, so that rounding never drops a point within eps ***
+            const double chord = chord_of( eps) * (1 + 1e-9) + 1e-12;
+            const double chord_sq = chord * chord;
+            const int64_t reach = static_cast<int64_t>( std::ceil( chord / _cell_size));
+            const Cell center = cell_of( q);
+            const double lat = p->data()[0];
+            const double lon = p->data()[1];
+
+            if( static_cast<double>( 2*reach+1) * (2*reach+1) > _cells.size()) {
+                // *** the query covers more columns than there are cells: scan all points ***
+                for( std::size_t i=0; i<_db.size(); ++i)
+                    check( i, q, chord_sq, lat, lon, eps, o_N_eps);
+                return;
+            }
+
+            Cell c;
+            for( c.x = center.x - reach; c.x <= center.x + reach; ++c.x) {
+                for( c.y = center.y - reach; c.y <= center.y + reach; ++c.y) {
+                    // *** the cells of a column are consecutive, so one search finds the first one ***
+                    Cell first = { c.x, c.y, center.z - reach };
+                    auto cell_it = std::lower_bound( _cells.begin(), _cells.end(), first);
+                    for( ; cell_it != _cells.end() && cell_it->x == c.x && cell_it->y == c.y && cell_it->z <= center.z + reach; ++cell_it) {
+                        const std::size_t cell_idx = cell_it - _cells.begin();
+
+                        for( std::size_t i=_offsets[cell_idx]; i<_offsets[cell_idx+1]; ++i)
+                            check( i, q, chord_sq, lat, lon, eps, o_N_eps);
+                    }
+                }
+            }
+        }
+
+    private: // helpers
+
+        /** Adds an indexed point to a neighborhood if it is within the query radius.
+         * @param i The index of the point in _db.
+         * @param q The position of the query point on the unit sphere.
+         * @param chord_sq The squared chord length that corresponds to the query radius, with some slack.
+         * @param lat The latitude of the query point in degrees.
+         * @param lon The longitude of the query point in degrees.
+         * @param eps The radius of the query.
+         * @param o_N_eps The neighborhood to extend.
+         */
+        inline void check( const std::size_t i, const double* q, const double chord_sq, const double lat, const double lon, const real eps, Neighborhood& o_N_eps) const {
+            const double dx = _xyz[3*i] - q[0];
+            const double dy = _xyz[3*i+1] - q[1];
+            const double dz = _xyz[3*i+2] - q[2];
+            if( dx*dx + dy*dy + dz*dz > chord_sq)
+                return;
+            const double d = haversine_distance( lat, lon, _db[i]->data()[0], _db[i]->data()[1], _radius);
+            if( d <= eps) {
+                Neighbor n = { _db[i], static_cast<real>( d*d) };
+                o_N_eps.push_back( n);
+            }
+        }
+
+        /** Converts a distance on the sphere to the length of the chord on the unit sphere.
+         * @param distance A distance on the sphere in the unit of the radius.
+         * @return The straight-line distance between two points on the unit sphere with the given distance.
+         */
+        inline double chord_of( const double distance) const {
+            const double half_angle = std::min( distance / (2*_radius), std::acos( 0.0));
+            return 2 * std::sin( half_angle);
+        }
+
+        /** Maps the latitude and longitude of a point to coordinates on the unit sphere.
+         * @param p The point, with latitude and longitude in degrees as its first two data elements.
+         * @param o_xyz Receives the 3 coordinates.
+         */
+        static inline void to_unit_sphere( const DataPoint* p, double* o_xyz) {
+            const double to_rad = std::acos( -1.0) / 180;
+            const double lat = p->data()[0] * to_rad;
+            const double lon = p->data()[1] * to_rad;
+            o_xyz[0] = std::cos( lat) * std::cos( lon);
+            o_xyz[1] = std::cos( lat) * std::sin( lon);
+            o_xyz[2] = std::sin( lat);
+        }
+
+        /** Retrieves the grid cell of a position.
+         * @param xyz The 3 coordinates of the position.
+         * @return The cell that contains the position.
+         */
+        inline Cell cell_of( const double* xyz) const {
+            Cell ret = {
+                static_cast<int64_t>( std::floor( xyz[0] / _cell_size)),
+                static_cast<int64_t>( std::floor( xyz[1] / _cell_size)),
+                static_cast<int64_t>( std::floor( xyz[2] / _cell_size)) };
+            return ret;
+        }
+    };
+
+
+
+    // FUNCTIONS ##################################################################################
+
+
+    /** Computes the great-circle distance between two locations with the haversine formula,
+     * which stays accurate for small distances.
+     * @param lat_a The latitude of the first location in degrees.
+     * @param lon_a The longitude of the first location in degrees.
+     * @param lat_b The latitude of the second location in degrees.
+     * @param lon_b The longitude of the second location in degrees.
+     * @param radius The radius of the sphere. Defines the unit of the distance.
+     * @return The distance between the locations. Not squared.
+     */
+    double haversine_distance( const double lat_a, const double lon_a, const double lat_b, const double lon_b, const double radius) {
+        const double to_rad = std::acos( -1.0) / 180;
+        const double sin_dlat = std::sin( (lat_b - lat_a) * to_rad / 2);
+        const double sin_dlon = std::sin( (lon_b - lon_a) * to_rad / 2);
+        const double h = sin_dlat*sin_dlat + std::cos( lat_a * to_rad) * std::cos( lat_b * to_rad) * sin_dlon*sin_dlon;
+        return 2 * radius * std::asin( std::min( 1.0, std::sqrt( h)));
+    }
+
+} // END namespace OPTICS
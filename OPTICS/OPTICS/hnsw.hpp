@@ -0,0 +1,460 @@
+/******************************************************************************
+/* @file Contains a hierarchical navigable small world (HNSW) graph for
+/*       approximate range and k-nearest-neighbor queries.
+/*
+/*
+/* @author langenhagen
+/* @version 261016
+/******************************************************************************/
+#pragma once
+
+///////////////////////////////////////////////////////////////////////////////
+// INCLUDES project headers
+
+#include "DataPoint.hpp"
+#include "thread_pool.hpp"
+
+///////////////////////////////////////////////////////////////////////////////
+//INCLUDES C/C++ standard library (and other external libraries)
+
+#include <algorithm> // sort, push_heap, pop_heap, min, max
+#include <cmath>
+#include <cstdint>
+#include <functional> // greater
+#include <mutex>
+#include <random>
+#include <utility>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+// NAMESPACE, CONSTANTS and TYPE DECLARATIONS/IMPLEMENTATIONS
+
+namespace OPTICS {
+
+    /** Implements a hierarchical navigable small world (HNSW) graph over a set of DataPoints for
+     * approximate queries, e.g. an approximate OPTICS with optics_indexed() on millions of
+     * high-dimensional points.
+     * Every point is a node on level 0 and, with exponentially decreasing probability, on higher
+     * levels, where it is linked to up to M of its near neighbors (2*M on level 0). A query descends
+     * greedily from the top level and runs a beam search of width ef_search on level 0.
+     * A range query then grows the result along the links of level 0 from all beam points within eps.
+     * The neighborhoods contain no false positives and exact distances, but may miss points. Since
+     * the beam holds the approximate ef_search nearest neighbors, the core distances of optics_indexed()
+     * are those of an approximate k-nearest-neighbor search if ef_search is at least min_pts.
+     * ef_search is the recall knob: greater values find more neighbors at a higher cost.
+     * The graph is built by inserting the points concurrently, with a lock per node.
+     * The index keeps per-query scratch memory, so one index must not be queried concurrently.
+     */
+    class HNSWIndex {
+
+    private: // types
+
+        /// A node and its squared distance to the query.
+        typedef std::pair<real, std::uint32_t> Candidate;
+
+        /// The scratch memory of a search.
+        struct Scratch {
+            std::vector<std::uint32_t> visited;     ///< The stamp of the search that visited a node last.
+            std::uint32_t stamp;                    ///< The stamp of the current search.
+            std::vector<Candidate> candidates;      ///< The min-heap of the nodes to expand.
+            std::vector<Candidate> results;         ///< The max-heap of the ef nearest nodes found.
+            std::vector<Candidate> selected;        ///< The selected neighbors of a new node.
+            std::vector<Candidate> overflow;        ///< The links of a node that overflowed, plus the new link.
+            std::vector<Candidate> pruned;          ///< The links kept of a node that overflowed.
+            std::vector<std::uint32_t> links;       ///< A copy of the links of a node.
+
+            explicit Scratch( const std::size_t n) : visited( n, 0), stamp( 0)
+            {}
+
+            /// Starts a new search, in which no node is visited yet.
+            inline void next_search() {
+                if( ++stamp == 0) {
+                    std::fill( visited.begin(), visited.end(), 0);
+                    stamp = 1;
+                }
+            }
+        };
+
+    private: // vars
+
+        unsigned int _dim;                      ///< The dimensionality of the points.
+        unsigned int _M;                        ///< The maximum number of links per node on the levels above 0.
+        unsigned int _M0;                       ///< The maximum number of links per node on level 0.
+        unsigned int _ef_construction;          ///< The beam width while building.
+        unsigned int _ef_search;                ///< The beam width of queries.
+        DataVector _db;                         ///< The indexed points.
+        std::vector<real> _coords;              ///< The coordinates of the points, _dim values per point.
+        std::vector<int> _levels;               ///< The top level of every node.
+        std::vector<std::uint32_t> _links0;     ///< The links on level 0: per node, the count followed by _M0 slots.
+        std::vector<std::vector<std::uint32_t>> _upper_links; ///< The links on the levels above 0: per node and level, the count followed by _M slots.
+        std::uint32_t _entry;                   ///< The entry node, on the top level.
+        int _max_level;                         ///< The top level.
+        mutable std::vector<std::mutex> _locks; ///< The locks of the links of every node while building.
+        std::mutex _entry_lock;                 ///< The lock of the entry node and the top level while building.
+        mutable Scratch _scratch;               ///< Scratch memory of the queries.
+
+    public: // ctor & dtor
+
+        /** Main constructor. Builds the graph in about O(n log n) distance computations.
+         * @param db The points to index. All points must have the same dimensionality.
+         * @param M The maximum number of links per node on the levels above 0, twice as many on level 0.
+         *        Must be at least 2. Greater values improve the recall and cost memory and time.
+         * @param ef_construction The beam width while building. Greater values improve the graph and cost time.
+         * @param ef_search The beam width of queries; see set_ef_search().
+         * @param seed The seed for the levels of the nodes.
+         * @param pool The thread pool that inserts the points.
+         */
+        HNSWIndex( const DataVector& db, const unsigned int M = 16, const unsigned int ef_construction = 128, const unsigned int ef_search = 64, const unsigned int seed = 42, ThreadPool& pool = default_pool())
+            : _dim( db.empty() ? 0 : static_cast<unsigned int>( db.front()->data().size())), _M( M), _M0( 2*M),
+              _ef_construction( std::max( ef_construction, M)), _ef_search( std::max( ef_search, 1u)), _db( db.begin(), db.end()),
+              _levels( db.size(), 0), _links0( db.size() * (2*M+1), 0), _upper_links( db.size()),
+              _entry( 0), _max_level( -1), _locks( db.size()), _scratch( db.size()) {
+            assert( M >= 2 && "M must be at least 2");
+            const std::size_t n = db.size();
+            if( n == 0)
+                return;
+
+            _coords.reserve( n * _dim);
+            for( std::size_t i=0; i<n; ++i) {
+                assert( db[i]->data().size() == _dim && "All points must have the same dimensionality");
+                _coords.insert( _coords.end(), db[i]->data().begin(), db[i]->data().end());
+            }
+
+            // *** the levels are drawn up front, so that they do not depend on the insertion schedule ***
+            std::mt19937 generator( seed);
+            std::uniform_real_distribution<double> uniform( 0.0, 1.0);
+            const double level_scale = 1.0 / std::log( static_cast<double>( M));
+            for( std::size_t i=0; i<n; ++i) {
+                _levels[i] = std::min( 31, static_cast<int>( -std::log( 1.0 - uniform( generator)) * level_scale));
+                _upper_links[i].assign( static_cast<std::size_t>( _levels[i]) * (M+1), 0);
+            }
+
+            _entry = 0;
+            _max_level = _levels[0];
+            pool.parallel_for( 1, n, 64, [this]( const std::size_t lower_idx, const std::size_t upper_idx) {
+                Scratch scratch( _db.size());
+                for( std::size_t i=lower_idx; i<upper_idx; ++i)
+                    insert( static_cast<std::uint32_t>( i), scratch);
+            });
+        }
+
+    private: // forbidden copy construction and assignment
+
+        HNSWIndex( const HNSWIndex&);
+        HNSWIndex& operator=( const HNSWIndex&);
+
+    public: // methods
+
+        /** Sets the beam width of queries, the recall knob of the index.
+         * @param ef_search The beam width. Should be at least min_pts. Greater values find more neighbors at a higher cost.
+         */
+        inline void set_ef_search( const unsigned int ef_search) { _ef_search = std::max( ef_search, 1u); }
+
+        /** Retrieves the beam width of queries.
+         * @return The beam width.
+         */
+        inline unsigned int ef_search() const { return _ef_search; }
+
+        /** Retrieves points within a given distance of a point, approximately.
+         * @param p The query point. Must have the dimensionality of the indexed points.
+         * @param eps The radius of the query.
+         * @param o_N_eps Receives points within the radius around p, usually including p itself if it is
+         *        indexed, together with their squared distances to p. The previous content is kept.
+         */
+        void range_query( const DataPoint* p, const real eps, Neighborhood& o_N_eps) const {
+            assert( eps >= 0 && "eps must not be negative");
+            assert( p->data().size() == _dim && "Query point must have the dimensionality of the indexed points");
+            if( _db.empty())
+                return;
+            const real* q = p->data().data();
+            const real eps_sq = eps*eps;
+            beam_search( q, _ef_search);
+
+            // grow the result along the links of level 0, from all beam points within eps
+            std::vector<std::uint32_t>& queue = _scratch.links;
+            queue.clear();
+            _scratch.next_search();
+            for( auto it=_scratch.results.begin(); it!=_scratch.results.end(); ++it) {
+                _scratch.visited[it->second] = _scratch.stamp;
+                if( it->first <= eps_sq) {
+                    Neighbor n = { _db[it->second], it->first };
+                    o_N_eps.push_back( n);
+                    queue.push_back( it->second);
+                }
+            }
+            for( std::size_t k=0; k<queue.size(); ++k) {
+                const std::uint32_t* links = &_links0[queue[k] * (_M0+1)];
+                for( std::uint32_t j=1; j<=links[0]; ++j) {
+                    const std::uint32_t nb = links[j];
+                    if( _scratch.visited[nb] == _scratch.stamp)
+                        continue;
+                    _scratch.visited[nb] = _scratch.stamp;
+                    const real d = distance( nb, q);
+                    if( d <= eps_sq) {
+                        Neighbor n = { _db[nb], d };
+                        o_N_eps.push_back( n);
+                        queue.push_back( nb);
+                    }
+                }
+            }
+        }
+
+        /** Retrieves the k nearest neighbors of a point, approximately.
+         * @param p The query point. Must have the dimensionality of the indexed points.
+         * @param k The number of neighbors.
+         * @param o_neighbors Receives up to k points, nearest first, together with their squared distances to p.
+         *        The previous content is kept.
+         */
+        void knn_query( const DataPoint* p, const unsigned int k, Neighborhood& o_neighbors) const {
+            assert( p->data().size() == _dim && "Query point must have the dimensionality of the indexed points");
+            if( _db.empty())
+                return;
+            beam_search( p->data().data(), std::max( _ef_search, k));
+            for( std::size_t i=0; i<_scratch.results.size() && i<k; ++i) {
+                Neighbor n = { _db[_scratch.results[i].second], _scratch.results[i].first };
+                o_neighbors.push_back( n);
+            }
+        }
+
+    private: // helpers
+
+        /** Runs a query: the greedy descent from the top level and a beam search on level 0.
+         * @param q The coordinates of the query.
+         * @param ef The beam width.
+         * @post _scratch.results holds the nearest nodes found, nearest first.
+         */
+        void beam_search( const real* q, const unsigned int ef) const {
+            std::uint32_t ep = _entry;
+            real ep_dist = distance( ep, q);
+            for( int level=_max_level; level>0; --level)
+                greedy_step( q, level, ep, ep_dist, _scratch, false);
+            search_level( q, ep, ep_dist, ef, 0, _scratch, false);
+            std::sort( _scratch.results.begin(), _scratch.results.end());
+        }
+
+        /** Inserts a node into the graph. Safe to call concurrently for different nodes.
+         * @param node The node.
+         * @param scratch The scratch memory of the calling thread.
+         */
+        void insert( const std::uint32_t node, Scratch& scratch) {
+            const int level = _levels[node];
+            const real* q = &_coords[static_cast<std::size_t>( node) * _dim];
+
+            // *** a node that raises the top level keeps the entry locked until it is fully linked ***
+            std::unique_lock<std::mutex> entry_guard( _entry_lock);
+            const int max_level = _max_level;
+            std::uint32_t ep = _entry;
+            if( level <= max_level)
+                entry_guard.unlock();
+
+            real ep_dist = distance( ep, q);
+            for( int lc=max_level; lc>level; --lc)
+                greedy_step( q, lc, ep, ep_dist, scratch, true);
+
+            for( int lc=std::min( level, max_level); lc>=0; --lc) {
+                search_level( q, ep, ep_dist, _ef_construction, lc, scratch, true);
+                std::sort( scratch.results.begin(), scratch.results.end());
+                ep = scratch.results.front().second;
+                ep_dist = scratch.results.front().first;
+
+                select_neighbors( scratch.results, _M, scratch.selected);
+                {
+                    std::lock_guard<std::mutex> guard( _locks[node]);
+                    std::uint32_t* links = links_of( node, lc);
+                    links[0] = 0;
+                    for( auto it=scratch.selected.begin(); it!=scratch.selected.end(); ++it)
+                        links[++links[0]] = it->second;
+                }
+                for( auto it=scratch.selected.begin(); it!=scratch.selected.end(); ++it)
+                    connect( it->second, node, it->first, lc, scratch);
+            }
+
+            if( level > max_level) {
+                _max_level = level;
+                _entry = node;
+            }
+        }
+
+        /** Adds a link from a node to a new node, pruning the links of the node if they overflow.
+         * @param node The node that receives the link.
+         * @param new_node The new node.
+         * @param d The squared distance between the nodes.
+         * @param level The level of the link.
+         * @param scratch The scratch memory of the calling thread.
+         */
+        void connect( const std::uint32_t node, const std::uint32_t new_node, const real d, const int level, Scratch& scratch) {
+            std::lock_guard<std::mutex> guard( _locks[node]);
+            std::uint32_t* links = links_of( node, level);
+            const std::uint32_t capacity = level == 0 ? _M0 : _M;
+            if( links[0] < capacity) {
+                links[++links[0]] = new_node;
+                return;
+            }
+
+            std::vector<Candidate>& candidates = scratch.overflow;
+            candidates.assign( 1, Candidate( d, new_node));
+            for( std::uint32_t j=1; j<=links[0]; ++j)
+                candidates.push_back( Candidate( node_distance( node, links[j]), links[j]));
+            std::sort( candidates.begin(), candidates.end());
+            select_neighbors( candidates, capacity, scratch.pruned);
+            links[0] = 0;
+            for( auto it=scratch.pruned.begin(); it!=scratch.pruned.end(); ++it)
+                links[++links[0]] = it->second;
+        }
+
+        /** Selects the links of a node with the heuristic of the HNSW paper: a candidate is kept only if
+         * it is closer to the node than to all candidates kept before, which spreads the links over all
+         * directions. Remaining slots are filled with the nearest discarded candidates.
+         * @param candidates The candidates with their squared distances to the node, nearest first.
+         * @param M The maximum number of links.
+         * @param o_selected Receives the selected candidates.
+         */
+        void select_neighbors( const std::vector<Candidate>& candidates, const unsigned int M, std::vector<Candidate>& o_selected) const {
+            o_selected.clear();
+            std::size_t n_discarded = 0;
+            std::vector<bool> is_selected( candidates.size(), false);
+            for( std::size_t i=0; i<candidates.size() && o_selected.size()<M; ++i) {
+                bool is_good = true;
+                for( auto it=o_selected.begin(); it!=o_selected.end() && is_good; ++it)
+                    is_good = node_distance( candidates[i].second, it->second) >= candidates[i].first;
+                if( is_good) {
+                    o_selected.push_back( candidates[i]);
+                    is_selected[i] = true;
+                } else {
+                    ++n_discarded;
+                }
+            }
+            for( std::size_t i=0; i<candidates.size() && o_selected.size()<M && n_discarded>0; ++i) {
+                if( !is_selected[i]) {
+                    o_selected.push_back( candidates[i]);
+                    --n_discarded;
+                }
+            }
+        }
+
+        /** Moves greedily to the node nearest to the query on one level.
+         * @param q The coordinates of the query.
+         * @param level The level.
+         * @param io_ep The current node; receives the nearest node found.
+         * @param io_ep_dist The squared distance of the current node; receives that of the nearest node found.
+         * @param scratch The scratch memory.
+         * @param lock Whether to lock the links of the nodes, i.e. whether the graph is being built.
+         */
+        void greedy_step( const real* q, const int level, std::uint32_t& io_ep, real& io_ep_dist, Scratch& scratch, const bool lock) const {
+            for( bool changed=true; changed; ) {
+                changed = false;
+                copy_links( io_ep, level, scratch.links, lock);
+                for( auto it=scratch.links.begin(); it!=scratch.links.end(); ++it) {
+                    const real d = distance( *it, q);
+                    if( d < io_ep_dist) {
+                        io_ep_dist = d;
+                        io_ep = *it;
+                        changed = true;
+                    }
+                }
+            }
+        }
+
+        /** Runs a beam search on one level.
+         * @param q The coordinates of the query.
+         * @param ep The node to start from.
+         * @param ep_dist The squared distance of the start node.
+         * @param ef The beam width.
+         * @param level The level.
+         * @param scratch The scratch memory. Receives the ef nearest nodes found in scratch.results, in heap order.
+         * @param lock Whether to lock the links of the nodes, i.e. whether the graph is being built.
+         */
+        void search_level( const real* q, const std::uint32_t ep, const real ep_dist, const unsigned int ef, const int level, Scratch& scratch, const bool lock) const {
+            std::vector<Candidate>& candidates = scratch.candidates;
+            std::vector<Candidate>& results = scratch.results;
+            const std::greater<Candidate> min_first;
+            candidates.assign( 1, Candidate( ep_dist, ep));
+            results.assign( 1, Candidate( ep_dist, ep));
+            scratch.next_search();
+            scratch.visited[ep] = scratch.stamp;
+
+            while( !candidates.empty()) {
+                const Candidate c = candidates.front();
+                if( c.first > results.front().first && results.size() >= ef)
+                    break;
+                std::pop_heap( candidates.begin(), candidates.end(), min_first);
+                candidates.pop_back();
+
+                copy_links( c.second, level, scratch.links, lock);
+                for( auto it=scratch.links.begin(); it!=scratch.links.end(); ++it) {
+                    if( scratch.visited[*it] == scratch.stamp)
+                        continue;
+                    scratch.visited[*it] = scratch.stamp;
+                    const real d = distance( *it, q);
+                    if( results.size() < ef || d < results.front().first) {
+                        candidates.push_back( Candidate( d, *it));
+                        std::push_heap( candidates.begin(), candidates.end(), min_first);
+                        results.push_back( Candidate( d, *it));
+                        std::push_heap( results.begin(), results.end());
+                        if( results.size() > ef) {
+                            std::pop_heap( results.begin(), results.end());
+                            results.pop_back();
+                        }
+                    }
+                }
+            }
+        }
+
+        /** Copies the links of a node on a level.
+         * @param node The node.
+         * @param level The level.
+         * @param o_links Receives the linked nodes.
+         * @param lock Whether to lock the links of the node.
+         */
+        inline void copy_links( const std::uint32_t node, const int level, std::vector<std::uint32_t>& o_links, const bool lock) const {
+            std::unique_lock<std::mutex> guard( _locks[node], std::defer_lock);
+            if( lock)
+                guard.lock();
+            const std::uint32_t* links = links_of( node, level);
+            o_links.assign( links + 1, links + 1 + links[0]);
+        }
+
+        /** Retrieves the links of a node on a level.
+         * @param node The node. Must be on the level.
+         * @param level The level.
+         * @return A pointer to the count of links, followed by the slots.
+         */
+        inline std::uint32_t* links_of( const std::uint32_t node, const int level) {
+            return level == 0 ? &_links0[static_cast<std::size_t>( node) * (_M0+1)] : &_upper_links[node][(level-1) * (_M+1)];
+        }
+
+        /** Retrieves the links of a node on a level.
+         * @param node The node. Must be on the level.
+         * @param level The level.
+         * @return A pointer to the count of links, followed by the slots.
+         */
+        inline const std::uint32_t* links_of( const std::uint32_t node, const int level) const {
+            return level == 0 ? &_links0[static_cast<std::size_t>( node) * (_M0+1)] : &_upper_links[node][(level-1) * (_M+1)];
+        }
+
+        /** Computes the squared distance between a node and a position.
+         * @param node The node.
+         * @param q The coordinates of the position.
+         * @return The squared euclidean distance.
+         */
+        inline real distance( const std::uint32_t node, const real* q) const {
+            const real* x = &_coords[static_cast<std::size_t>( node) * _dim];
+            real ret = 0;
+            for( unsigned int k=0; k<_dim; ++k) {
+                const real diff = x[k] - q[k];
+                ret += diff*diff;
+            }
+            return ret;
+        }
+
+        /** Computes the squared distance between two nodes.
+         * @param a The first node.
+         * @param b The second node.
+         * @return The squared euclidean distance.
+         */
+        inline real node_distance( const std::uint32_t a, const std::uint32_t b) const {
+            return distance( a, &_coords[static_cast<std::size_t>( b) * _dim]);
+        }
+    };
+
+} // END namespace OPTICS
@@ -0,0 +1,439 @@
+/******************************************************************************
+/* @file Contains the KDTree class, a spatial index for range and k-nearest
+/*       neighbor queries on DataPoints under the squared euclidean distance.
+/*
+/*
+/* @author langenhagen
+/* @version 261016
+/******************************************************************************/
+#pragma once
+
+///////////////////////////////////////////////////////////////////////////////
+// INCLUDES project headers
+
+#include "DataPoint.hpp"
+#include "thread_pool.hpp"
+
+///////////////////////////////////////////////////////////////////////////////
+//INCLUDES C/C++ standard library (and other external libraries)
+
+#include <algorithm> // nth_element, push_heap, pop_heap
+#include <utility>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+// NAMESPACE, CONSTANTS and TYPE DECLARATIONS/IMPLEMENTATIONS
+
+namespace OPTICS {
+
+    /** Implements a k-d tree over a set of DataPoints.
+     * The coordinates are copied into one contiguous array in tree order, so that the points
+     * of a leaf lie next to each other in memory. Every node stores its bounding box, which is
+     * used to prune subtrees during queries. The tree is static, i.e. points cannot be added later.
+     */
+    class KDTree {
+
+    private: // types
+
+        /// A node of the tree. Inner nodes have two children, leaves have none.
+        struct Node {
+            unsigned int begin; ///< The index of the first point of the node.
+            unsigned int end;   ///< The index behind the last point of the node.
+            int left;           ///< The index of the left child, or -1 for leaves.
+            int right;          ///< The index of the right child, or -1 for leaves.
+        };
+
+    private: // vars
+
+        unsigned int _dim;              ///< The dimensionality of the points.
+        unsigned int _leaf_size;        ///< The maximum number of points in a leaf.
+        std::vector<DataPoint*> _points;///< The points in tree order.
+        std::vector<real> _coords;      ///< The coordinates of the points in tree order, _dim values per point.
+        std::vector<Node> _nodes;       ///< The nodes. The root is the first node.
+        std::vector<real> _boxes;       ///< The bounding boxes of the nodes, _dim minima followed by _dim maxima per node.
+
+    public: // ctor & dtor
+
+        /** Main constructor.
+         * Builds the tree over the given points in O(n log n).
+         * @param db The points to index. All points must have the same dimensionality.
+         * @param leaf_size The maximum number of points in a leaf. Must be greater than 0.
+         * @param pool The thread pool that builds the subtrees below the top levels.
+         */
+        explicit KDTree( const DataVector& db, const unsigned int leaf_size = 16, ThreadPool& pool = default_pool())
+            : _dim( db.empty() ? 0 : static_cast<unsigned int>(db.front()->data().size())), _leaf_size( leaf_size), _points( db.begin(), db.end()) {
+            assert( leaf_size > 0 && "leaf_size must be greater than 0");
+            _coords.reserve( _points.size() * _dim);
+            for( auto it=_points.begin(); it!=_points.end(); ++it) {
+                assert( (*it)->data().size() == _dim && "All DataPoints must have same dimensionality");
+                _coords.insert( _coords.end(), (*it)->data().begin(), (*it)->data().end());
+            }
+            build( pool);
+        }
+
+    public: // methods
+
+        /** Retrieves the number of indexed points.
+         * @return The number of indexed points.
+         */
+        inline std::size_t size() const { return _points.size(); }
+
+        /** Retrieves all indexed points within a given radius around a query point.
+         * @param p The query point. Must have the dimensionality of the indexed points.
+         * @param eps The radius of the query.
+         * @param o_N_eps Receives all points within the radius around p, including p itself
+         *        if it is indexed, together with their squared distances to p. The previous content is kept.
+         */
+        void range_query( const DataPoint* p, const real eps, Neighborhood& o_N_eps) const {
+            assert( eps >= 0 && "eps must not be negative");
+            assert( p->data().size() == _dim && "Query point must have the dimensionality of the indexed points");
+            if( _nodes.empty())
+                return;
+
+            const real* q = p->data().data();
+            const real eps_sq = eps*eps;
+            int stack[64];
+            int top = 0;
+            stack[top++] = 0;
+
+            while( top > 0) {
+                const int n = stack[--top];
+                if( box_distance( n, q) > eps_sq)
+                    continue;
+
+                const Node& node = _nodes[n];
+                if( node.left < 0) {
+                    for( unsigned int i=node.begin; i<node.end; ++i) {
+                        const real d = distance( i, q);
+                        if( d <= eps_sq) {
+                            Neighbor neighbor = { _points[i], d };
+                            o_N_eps.push_back( neighbor);
+                        }
+                    }
+                } else {
+                    stack[top++] = node.right;
+                    stack[top++] = node.left;
+                }
+            }
+        }
+
+        /** Finds the squared distance from a query point to its k-th nearest indexed point.
+         * If the query point is indexed itself, it counts as its own nearest neighbor.
+         * Subtrees are visited closest first and pruned against a bounded max-heap of the k best distances.
+         * @param p The query point. Must have the dimensionality of the indexed points.
+         * @param k The rank of the neighbor. Must be greater than 0.
+         * @return The squared distance to the k-th nearest point, or OPTICS::UNDEFINED if less than k points are indexed.
+         */
+        real kth_nearest_distance( const DataPoint* p, const unsigned int k) const {
+            std::vector<real> heap;
+            return kth_nearest_distance( p, k, heap);
+        }
+
+        /** Finds the squared distance from a query point to its k-th nearest indexed point,
+         * with a caller-owned buffer, so that repeated queries do not allocate.
+         * If the query point is indexed itself, it counts as its own nearest neighbor.
+         * @param p The query point. Must have the dimensionality of the indexed points.
+         * @param k The rank of the neighbor. Must be greater than 0.
+         * @param heap A scratch buffer for the k best distances. Its content is overwritten.
+         * @return The squared distance to the k-th nearest point, or OPTICS::UNDEFINED if less than k points are indexed.
+         */
+        real kth_nearest_distance( const DataPoint* p, const unsigned int k, std::vector<real>& heap) const {
+            assert( k > 0 && "k must be greater than 0");
+            assert( p->data().size() == _dim && "Query point must have the dimensionality of the indexed points");
+            if( _points.size() < k)
+                return OPTICS::UNDEFINED;
+
+            const real* q = p->data().data();
+            heap.clear(); // the k smallest distances, largest on top
+            int stack[64];
+            int top = 0;
+            stack[top++] = 0;
+
+            while( top > 0) {
+                const int n = stack[--top];
+                if( heap.size() == k && box_distance( n, q) >= heap.front())
+                    continue;
+
+                const Node& node = _nodes[n];
+                if( node.left < 0) {
+                    for( unsigned int i=node.begin; i<node.end; ++i) {
+                        const real d = distance( i, q);
+                        if( heap.size() < k) {
+                            heap.push_back( d);
+                            std::push_heap( heap.begin(), heap.end());
+                        } else if( d < heap.front()) {
+                            std::pop_heap( heap.begin(), heap.end());
+                            heap.back() = d;
+                            std::push_heap( heap.begin(), heap.end());
+                        }
+                    }
+                } else if( box_distance( node.left, q) < box_distance( node.right, q)) {
+                    stack[top++] = node.right;
+                    stack[top++] = node.left;
+                } else {
+                    stack[top++] = node.left;
+                    stack[top++] = node.right;
+                }
+            }
+            return heap.front();
+        }
+
+        /** Retrieves the point at a position in tree order.
+         * @param i The position of the point. Must be less than size().
+         * @return The point.
+         */
+        inline DataPoint* point( const unsigned int i) const { return _points[i]; }
+
+        /** Counts the unprocessed points below every node, for nearest_unprocessed().
+         * @param o_counts Receives the number of unprocessed points of every node.
+         */
+        void count_unprocessed( std::vector<unsigned int>& o_counts) const {
+            o_counts.assign( _nodes.size(), 0);
+            for( std::size_t n=_nodes.size(); n-->0; ) {
+                // *** children come after their parents ***
+                const Node& node = _nodes[n];
+                if( node.left >= 0) {
+                    o_counts[n] = o_counts[node.left] + o_counts[node.right];
+                } else {
+                    for( unsigned int i=node.begin; i<node.end; ++i)
+                        o_counts[n] += _points[i]->is_processed() ? 0 : 1;
+                }
+            }
+        }
+
+        /** Removes a point that has just been processed from the counts of count_unprocessed().
+         * @param i The position of the point in tree order.
+         * @param counts The counts of the unprocessed points of every node.
+         */
+        void remove_unprocessed( const unsigned int i, std::vector<unsigned int>& counts) const {
+            int n = 0;
+            for( ;;) {
+                --counts[n];
+                const Node& node = _nodes[n];
+                if( node.left < 0)
+                    break;
+                n = i < _nodes[node.left].end ? node.left : node.right;
+            }
+        }
+
+        /** Finds the unprocessed point with the smallest value max( floor, squared distance) to an indexed point.
+         * This is the next point that an indexed core point with the squared core distance floor reaches
+         * in Prim's algorithm on the mutual reachability graph. Ties are broken by the smaller address,
+         * like Comp_DataPoint_Ptr_f does. Subtrees without unprocessed points are pruned.
+         * @param i The position of the query point in tree order.
+         * @param floor The lower bound of the values, e.g. the squared core distance of the query point.
+         * @param counts The counts of the unprocessed points of every node, as kept by count_unprocessed()
+         *        and remove_unprocessed().
+         * @param o_value Receives the value max( floor, squared distance) of the found point.
+         * @return The position of the found point in tree order, or -1 if all points are processed.
+         */
+        int nearest_unprocessed( const unsigned int i, const real floor, const std::vector<unsigned int>& counts, real& o_value) const {
+            const real* q = &_coords[i * _dim];
+            int ret = -1;
+            o_value = OPTICS::UNDEFINED;
+            std::pair<int, real> stack[64]; // nodes with the squared distances to their boxes
+            int top = 0;
+            stack[top++] = std::make_pair( 0, box_distance( 0, q));
+
+            while( top > 0) {
+                const int n = stack[--top].first;
+                if( counts[n] == 0 || std::max( floor, stack[top].second) > o_value)
+                    continue;
+
+                const Node& node = _nodes[n];
+                if( node.left < 0) {
+                    for( unsigned int j=node.begin; j<node.end; ++j) {
+                        if( _points[j]->is_processed())
+                            continue;
+                        const real value = std::max( floor, distance( j, q));
+                        if( value < o_value || (value == o_value && _points[j] < _points[ret])) {
+                            o_value = value;
+                            ret = static_cast<int>( j);
+                        }
+                    }
+                } else {
+                    const std::pair<int, real> left( node.left, box_distance( node.left, q));
+                    const std::pair<int, real> right( node.right, box_distance( node.right, q));
+                    const bool is_left_closer = left.second < right.second;
+                    stack[top++] = is_left_closer ? right : left;
+                    stack[top++] = is_left_closer ? left : right;
+                }
+            }
+            return ret;
+        }
+
+    private: // helpers
+
+        /** Builds the tree over _points and _coords by recursively splitting at the median of the widest dimension.
+         * The top levels are split on the calling thread until there are enough subtrees to keep
+         * the pool busy. The subtrees are then built in parallel and appended to the node array.
+         * @param pool The thread pool that builds the subtrees.
+         */
+        void build( ThreadPool& pool) {
+            const unsigned int n = static_cast<unsigned int>(_points.size());
+            if( n == 0)
+                return;
+
+            std::vector<unsigned int> order( n);
+            for( unsigned int i=0; i<n; ++i)
+                order[i] = i;
+
+            Node root = { 0, n, -1, -1 };
+            _nodes.push_back( root);
+
+            // split the top levels, collecting the nodes at the parallel depth
+            unsigned int parallel_depth = 0;
+            while( (1u << parallel_depth) < 4 * pool.size() && parallel_depth < 16)
+                ++parallel_depth;
+
+            std::vector<std::pair<int, unsigned int>> todo( 1, std::make_pair( 0, 0u)); // nodes with their depth
+            std::vector<int> subtrees;
+            while( !todo.empty()) {
+                const int idx = todo.back().first;
+                const unsigned int depth = todo.back().second;
+                todo.pop_back();
+
+                if( depth == parallel_depth && pool.size() > 0) {
+                    subtrees.push_back( idx);
+                } else if( split( idx, order, _nodes, _boxes)) {
+                    todo.push_back( std::make_pair( _nodes[idx].right, depth+1));
+                    todo.push_back( std::make_pair( _nodes[idx].left, depth+1));
+                }
+            }
+
+            // build the subtrees in parallel, each with node indices of its own
+            std::vector<std::vector<Node>> subtree_nodes( subtrees.size());
+            std::vector<std::vector<real>> subtree_boxes( subtrees.size());
+            pool.parallel_for( 0, subtrees.size(), 1, [&]( const std::size_t lower_idx, const std::size_t upper_idx) {
+                for( std::size_t s=lower_idx; s<upper_idx; ++s) {
+                    std::vector<Node>& nodes = subtree_nodes[s];
+                    std::vector<real>& boxes = subtree_boxes[s];
+                    const Node& subtree_root = _nodes[subtrees[s]];
+                    Node local_root = { subtree_root.begin, subtree_root.end, -1, -1 };
+                    nodes.push_back( local_root);
+
+                    std::vector<int> local_todo( 1, 0);
+                    while( !local_todo.empty()) {
+                        const int idx = local_todo.back();
+                        local_todo.pop_back();
+                        if( split( idx, order, nodes, boxes)) {
+                            local_todo.push_back( nodes[idx].right);
+                            local_todo.push_back( nodes[idx].left);
+                        }
+                    }
+                }
+            });
+
+            // append the subtrees; their roots replace the nodes they were built from
+            for( std::size_t s=0; s<subtrees.size(); ++s) {
+                const std::vector<Node>& nodes = subtree_nodes[s];
+                const int offset = static_cast<int>(_nodes.size()) - 1;
+                for( std::size_t i=0; i<nodes.size(); ++i) {
+                    Node node = nodes[i];
+                    node.left = node.left < 0 ? -1 : node.left + offset;
+                    node.right = node.right < 0 ? -1 : node.right + offset;
+                    const int idx = i == 0 ? subtrees[s] : static_cast<int>(_nodes.size());
+                    if( i == 0)
+                        _nodes[idx] = node;
+                    else
+                        _nodes.push_back( node);
+                    _boxes.resize( _nodes.size() * 2 * _dim);
+                    std::copy( subtree_boxes[s].begin() + i*2*_dim, subtree_boxes[s].begin() + (i+1)*2*_dim, _boxes.begin() + idx*2*_dim);
+                }
+            }
+
+            // bring points and coordinates into tree order
+            std::vector<DataPoint*> points( n);
+            std::vector<real> coords( _coords.size());
+            for( unsigned int i=0; i<n; ++i) {
+                points[i] = _points[order[i]];
+                std::copy( _coords.begin() + order[i]*_dim, _coords.begin() + (order[i]+1)*_dim, coords.begin() + i*_dim);
+            }
+            _points.swap( points);
+            _coords.swap( coords);
+        }
+
+        /** Computes the bounding box of a node and splits it at the median of its widest dimension,
+         * unless it is small enough to become a leaf.
+         * @param idx The index of the node within nodes.
+         * @param order The permutation of the points. The range of the node is partitioned around the median.
+         * @param nodes The nodes. The children are appended.
+         * @param boxes The bounding boxes of the nodes. The box of the node is written.
+         * @return true if the node was split, false if it is a leaf.
+         */
+        bool split( const int idx, std::vector<unsigned int>& order, std::vector<Node>& nodes, std::vector<real>& boxes) const {
+            const unsigned int begin = nodes[idx].begin;
+            const unsigned int end = nodes[idx].end;
+
+            // compute the bounding box
+            boxes.resize( nodes.size() * 2 * _dim);
+            real* lo = &boxes[idx * 2 * _dim];
+            real* hi = lo + _dim;
+            for( unsigned int d=0; d<_dim; ++d) {
+                lo[d] = OPTICS::UNDEFINED;
+                hi[d] = -OPTICS::UNDEFINED;
+            }
+            for( unsigned int i=begin; i<end; ++i) {
+                const real* c = &_coords[order[i] * _dim];
+                for( unsigned int d=0; d<_dim; ++d) {
+                    lo[d] = std::min( lo[d], c[d]);
+                    hi[d] = std::max( hi[d], c[d]);
+                }
+            }
+
+            if( end - begin <= _leaf_size || _dim == 0)
+                return false;
+
+            unsigned int split_dim = 0;
+            for( unsigned int d=1; d<_dim; ++d) {
+                if( hi[d]-lo[d] > hi[split_dim]-lo[split_dim])
+                    split_dim = d;
+            }
+            if( hi[split_dim] == lo[split_dim])
+                return false; // all points are equal
+
+            const unsigned int mid = begin + (end-begin) / 2;
+            const std::vector<real>& coords = _coords;
+            const unsigned int dim = _dim;
+            std::nth_element( order.begin()+begin, order.begin()+mid, order.begin()+end, [&coords, dim, split_dim]( unsigned int a, unsigned int b) {
+                return coords[a*dim + split_dim] < coords[b*dim + split_dim];
+            });
+
+            Node left = { begin, mid, -1, -1 };
+            Node right = { mid, end, -1, -1 };
+            nodes[idx].left = static_cast<int>(nodes.size());
+            nodes.push_back( left);
+            nodes[idx].right = static_cast<int>(nodes.size());
+            nodes.push_back( right);
+            return true;
+        }
+
+        /** Retrieves the squared distance of a query point to the i-th point in tree order.
+         * @param i The index of the point in tree order.
+         * @param q The coordinates of the query point.
+         */
+        inline real distance( const unsigned int i, const real* q) const {
+            const real* c = &_coords[i * _dim];
+            real ret(0);
+            for( unsigned int d=0; d<_dim; ++d)
+                ret += (c[d]-q[d]) * (c[d]-q[d]);
+            return ret;
+        }
+
+        /** Retrieves the squared distance of a query point to the bounding box of a node.
+         * @param n The index of the node.
+         * @param q The coordinates of the query point.
+         */
+        inline real box_distance( const int n, const real* q) const {
+            const real* lo = &_boxes[n * 2 * _dim];
+            const real* hi = lo + _dim;
+            real ret(0);
+            for( unsigned int d=0; d<_dim; ++d) {
+                const real diff = q[d] < lo[d] ? lo[d]-q[d] : q[d] > hi[d] ? q[d]-hi[d] : 0;
+                ret += diff * diff;
+            }
+            return ret;
+        }
+    };
+
+} // END namespace OPTICS
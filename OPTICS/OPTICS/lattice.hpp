@@ -0,0 +1,407 @@
+/******************************************************************************
+/* @file Contains the Lattice class, an occupancy bitmap of a 2D or 3D integer
+/*       grid, and a variant of the OPTICS algorithm specialized for it.
+/*
+/*
+/* @author langenhagen
+/* @version 261016
+/******************************************************************************/
+#pragma once
+
+///////////////////////////////////////////////////////////////////////////////
+// INCLUDES project headers
+
+#include "common.hpp"
+
+///////////////////////////////////////////////////////////////////////////////
+//INCLUDES C/C++ standard library (and other external libraries)
+
+#include <algorithm> // sort, push_heap, pop_heap
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <functional> // greater
+#include <utility>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+// NAMESPACE, CONSTANTS and TYPE DECLARATIONS/IMPLEMENTATIONS
+
+namespace OPTICS {
+
+    /** Implements the occupied cells of a 2D bitmap or a 3D voxel volume as the points of a dataset.
+     * Only one bit per cell is stored, no coordinates. The occupied cells are numbered in raster order,
+     * x fastest, then y, then z; these numbers are the point indices of optics_lattice().
+     * A point index is mapped to its cell through a table, and a cell to its point index through
+     * the number of occupied cells before its bitmap word plus a popcount within the word.
+     * Cell indices are 64 bit, point indices 32 bit: at most UINT32_MAX cells may be occupied.
+     */
+    class Lattice {
+
+    private: // vars
+
+        unsigned int _width;                ///< The extent along x.
+        unsigned int _height;               ///< The extent along y.
+        unsigned int _depth;                ///< The extent along z. 1 for 2D bitmaps.
+        std::vector<std::uint64_t> _bits;   ///< The occupancy bitmap, one bit per cell in raster order.
+        std::vector<std::uint32_t> _ranks;  ///< The number of occupied cells before each bitmap word.
+        std::vector<std::size_t> _cells;    ///< The cell of every point. The lattice may have more than 2^32 cells.
+
+    public: // ctor & dtor
+
+        /** Main constructor. Creates an empty lattice.
+         * @param width The extent along x.
+         * @param height The extent along y.
+         * @param depth The extent along z. 1 for 2D bitmaps.
+         */
+        Lattice( const unsigned int width, const unsigned int height, const unsigned int depth = 1)
+            : _width( width), _height( height), _depth( depth), _bits( (cell_count() + 63) / 64, 0) {
+            update_index();
+        }
+
+        /** Convenience constructor. Creates a lattice from a mask.
+         * @param mask One value per cell in raster order, x fastest. Nonzero values mark occupied cells.
+         * @param width The extent along x.
+         * @param height The extent along y.
+         * @param depth The extent along z. 1 for 2D bitmaps.
+         */
+        Lattice( const std::uint8_t* mask, const unsigned int width, const unsigned int height, const unsigned int depth = 1)
+            : _width( width), _height( height), _depth( depth), _bits( (cell_count() + 63) / 64, 0) {
+            for( std::size_t c=0; c<cell_count(); ++c) {
+                if( mask[c])
+                    _bits[c / 64] |= std::uint64_t(1) << (c % 64);
+            }
+            update_index();
+        }
+
+    public: // methods
+
+        /** Marks a cell as occupied or free.
+         * The point indices are outdated afterwards until update_index() is called.
+         * @param x The x coordinate.
+         * @param y The y coordinate.
+         * @param z The z coordinate.
+         * @param occupied Whether the cell is occupied.
+         */
+        inline void set( const unsigned int x, const unsigned int y, const unsigned int z = 0, const bool occupied = true) {
+            const std::size_t c = cell( x, y, z);
+            if( occupied)
+                _bits[c / 64] |= std::uint64_t(1) << (c % 64);
+            else
+                _bits[c / 64] &= ~(std::uint64_t(1) << (c % 64));
+        }
+
+        /** Renumbers the points after cells have been set. Takes O(cells / 64 + points) time.
+         * The number of occupied cells must not exceed UINT32_MAX, since points are indexed with 32 bits.
+         */
+        void update_index() {
+            _ranks.resize( _bits.size());
+            _cells.clear();
+            std::uint32_t rank = 0;
+            for( std::size_t w=0; w<_bits.size(); ++w) {
+                _ranks[w] = rank;
+                for( std::uint64_t word=_bits[w]; word; word &= word-1) {
+                    assert( rank < UINT32_MAX && "The number of occupied cells must not exceed UINT32_MAX");
+                    _cells.push_back( w*64 + trailing_zeros( word));
+                    ++rank;
+                }
+            }
+        }
+
+        /** Retrieves whether a cell is occupied.
+         * @param x The x coordinate.
+         * @param y The y coordinate.
+         * @param z The z coordinate.
+         * @return true if the cell is occupied, false otherwise.
+         */
+        inline bool is_occupied( const unsigned int x, const unsigned int y, const unsigned int z = 0) const {
+            return is_occupied( cell( x, y, z));
+        }
+
+        /** Retrieves whether a cell is occupied.
+         * @param c The cell index in raster order.
+         * @return true if the cell is occupied, false otherwise.
+         */
+        inline bool is_occupied( const std::size_t c) const {
+            return (_bits[c / 64] >> (c % 64)) & 1;
+        }
+
+        /** Retrieves the index of a cell in raster order.
+         * @param x The x coordinate.
+         * @param y The y coordinate.
+         * @param z The z coordinate.
+         * @return The cell index.
+         */
+        inline std::size_t cell( const unsigned int x, const unsigned int y, const unsigned int z = 0) const {
+            assert( x < _width && y < _height && z < _depth && "Coordinates must be within the lattice");
+            return x + std::size_t(_width) * (y + std::size_t(_height) * z);
+        }
+
+        /** Retrieves the point index of an occupied cell.
+         * @param c The cell index in raster order. The cell must be occupied.
+         * @return The point index.
+         */
+        inline std::uint32_t point_at( const std::size_t c) const {
+            assert( is_occupied( c) && "The cell must be occupied");
+            const std::uint64_t below = (std::uint64_t(1) << (c % 64)) - 1;
+            return _ranks[c / 64] + popcount( _bits[c / 64] & below);
+        }
+
+        /** Retrieves the cell of a point.
+         * @param idx The point index.
+         * @return The cell index in raster order.
+         */
+        inline std::size_t cell_of( const std::uint32_t idx) const {
+            assert( idx < _cells.size() && "Index must be within the range of the points.");
+            return _cells[idx];
+        }
+
+        /** Retrieves the coordinates of a point.
+         * @param idx The point index.
+         * @param o_x Receives the x coordinate.
+         * @param o_y Receives the y coordinate.
+         * @param o_z Receives the z coordinate.
+         */
+        inline void coordinates( const std::uint32_t idx, unsigned int& o_x, unsigned int& o_y, unsigned int& o_z) const {
+            const std::size_t c = cell_of( idx);
+            o_x = static_cast<unsigned int>(c % _width);
+            o_y = static_cast<unsigned int>((c / _width) % _height);
+            o_z = static_cast<unsigned int>(c / (std::size_t(_width) * _height));
+        }
+
+        /** Retrieves the number of points, i.e. of occupied cells, as of the last update_index().
+         * @return The number of points.
+         */
+        inline std::size_t size() const { return _cells.size(); }
+
+        /// Retrieves the extent along x.
+        inline unsigned int width() const { return _width; }
+
+        /// Retrieves the extent along y.
+        inline unsigned int height() const { return _height; }
+
+        /// Retrieves the extent along z.
+        inline unsigned int depth() const { return _depth; }
+
+    private: // helpers
+
+        /// Retrieves the number of cells.
+        inline std::size_t cell_count() const { return std::size_t(_width) * _height * _depth; }
+
+        /** Counts the set bits of a word.
+         * @param x The word.
+         * @return The number of set bits.
+         */
+        static inline std::uint32_t popcount( std::uint64_t x) {
+            x = x - ((x >> 1) & 0x5555555555555555ull);
+            x = (x & 0x3333333333333333ull) + ((x >> 2) & 0x3333333333333333ull);
+            x = (x + (x >> 4)) & 0x0f0f0f0f0f0f0f0full;
+            return static_cast<std::uint32_t>( (x * 0x0101010101010101ull) >> 56);
+        }
+
+        /** Counts the trailing zero bits of a word.
+         * @param x The word. Must not be 0.
+         * @return The index of the lowest set bit.
+         */
+        static inline std::uint32_t trailing_zeros( const std::uint64_t x) {
+            return popcount( (x & (0-x)) - 1);
+        }
+    };
+
+
+    /** The result of optics_lattice(). Points are identified by their index within the Lattice.
+     * The distances are squared, like everywhere in the OPTICS module.
+     */
+    struct LatticeOrdering {
+        std::vector<std::uint32_t> points;      ///< The point indices in OPTICS order.
+        std::vector<real> reachability_distances;///< The squared reachability distance of every point, by point index.
+        std::vector<real> core_distances;       ///< The squared core distance of every point, by point index.
+    };
+
+
+    /// An offset of a stencil, i.e. a neighbor cell relative to a center cell.
+    struct StencilOffset {
+        int dx;         ///< The offset along x.
+        int dy;         ///< The offset along y.
+        int dz;         ///< The offset along z.
+        real distance;  ///< The squared length of the offset.
+    };
+
+
+    /// A neighbor within a lattice: a point index and its squared distance.
+    struct LatticeNeighbor {
+        std::uint32_t index;    ///< The point index of the neighbor.
+        real distance;          ///< The squared distance to the neighbor.
+    };
+
+
+
+    // FUNCTION DECLARATIONS ######################################################################
+
+    LatticeOrdering optics_lattice( const Lattice& lattice, const real eps, const unsigned int min_pts);
+
+    // helpers
+    std::vector<StencilOffset> lattice_stencil( const Lattice& lattice, const real eps);
+    real get_lattice_neighbors( const Lattice& lattice,
+                                const std::uint32_t p,
+                                const std::vector<StencilOffset>& stencil,
+                                const unsigned int min_pts,
+                                std::vector<LatticeNeighbor>& o_N_eps);
+
+
+
+    // LATTICE VERSION ############################################################################
+
+
+    /** Performs the OPTICS algorithm on the occupied cells of a lattice.
+     * The epsilon-neighborhood of a cell is the same set of offsets everywhere, so it is precomputed
+     * once as a stencil sorted by distance. The neighbors of a point are found by probing the
+     * occupancy bitmap at the stencil offsets, and the core distance is the distance of the stencil
+     * offset at which the (min_pts+1)-th occupied cell is met. Every point thus costs time proportional
+     * to the stencil size, independent of the number of points.
+     * The result equals the result of optics() on DataPoints with the cell coordinates, stored
+     * contiguously in raster order.
+     * @param lattice The lattice.
+     * @param eps The epsilon representing the radius of the epsilon-neighborhood, in cells.
+     * @param min_pts The minimum number of points to be found within an epsilon-neigborhood.
+     * @return The OPTICS ordering with reachability-distances and core-distances.
+     */
+    LatticeOrdering optics_lattice( const Lattice& lattice, const real eps, const unsigned int min_pts) {
+        assert( eps >= 0 && "eps must not be negative");
+        assert( min_pts > 0 && "min_pts must be greater than 0");
+        const std::uint32_t n = static_cast<std::uint32_t>(lattice.size());
+        const std::vector<StencilOffset> stencil = lattice_stencil( lattice, eps);
+
+        LatticeOrdering ret;
+        ret.points.reserve( n);
+        ret.reachability_distances.assign( n, OPTICS::UNDEFINED);
+        ret.core_distances.assign( n, OPTICS::UNDEFINED);
+        std::vector<bool> processed( n, false);
+        std::vector<real>& reach = ret.reachability_distances;
+
+        // the seeds as a lazy-deletion heap of (reachability distance, point index), like SeedHeap
+        typedef std::pair<real, std::uint32_t> Seed;
+        std::vector<Seed> seeds;
+        const std::greater<Seed> top_is_smallest;
+        std::vector<LatticeNeighbor> N_eps;
+        N_eps.reserve( stencil.size());
+
+        for( std::uint32_t start=0; start<n; ++start) {
+            if( processed[start])
+                continue;
+
+            std::uint32_t q = start;
+            for(;;) {
+                const real c_dist = get_lattice_neighbors( lattice, q, stencil, min_pts, N_eps);
+                ret.core_distances[q] = c_dist;
+                processed[q] = true;
+                ret.points.push_back( q);
+
+                if( c_dist != OPTICS::UNDEFINED) {
+                    // *** q is a core-object ***
+                    for( auto it=N_eps.begin(); it!=N_eps.end(); ++it) {
+                        const std::uint32_t o = it->index;
+                        if( processed[o])
+                            continue;
+                        const real new_r_dist = std::max( c_dist, it->distance);
+                        if( new_r_dist < reach[o]) {
+                            reach[o] = new_r_dist;
+                            seeds.push_back( Seed( new_r_dist, o));
+                            std::push_heap( seeds.begin(), seeds.end(), top_is_smallest);
+                        }
+                    }
+                }
+
+                // pop the next valid seed
+                bool found = false;
+                while( !seeds.empty() && !found) {
+                    const Seed top = seeds.front();
+                    std::pop_heap( seeds.begin(), seeds.end(), top_is_smallest);
+                    seeds.pop_back();
+                    if( !processed[top.second] && reach[top.second] == top.first) {
+                        q = top.second;
+                        found = true;
+                    }
+                }
+                if( !found)
+                    break;
+            }
+        }
+        return ret;
+    }
+
+
+    // HELPERS ####################################################################################
+
+
+    /** Computes the offsets of all cells within a given radius around a cell, sorted by distance.
+     * Offsets that cannot lie within the lattice are left out.
+     * @param lattice The lattice.
+     * @param eps The radius, in cells.
+     * @return The offsets, sorted by their squared lengths. The first offset is (0,0,0).
+     */
+    std::vector<StencilOffset> lattice_stencil( const Lattice& lattice, const real eps) {
+        const real eps_sq = eps*eps;
+        const double radius = std::floor( static_cast<double>(eps));
+        const int rx = static_cast<int>( std::min<double>( radius, lattice.width() > 0 ? lattice.width()-1 : 0));
+        const int ry = static_cast<int>( std::min<double>( radius, lattice.height() > 0 ? lattice.height()-1 : 0));
+        const int rz = static_cast<int>( std::min<double>( radius, lattice.depth() > 0 ? lattice.depth()-1 : 0));
+
+        std::vector<StencilOffset> ret;
+        for( int dz=-rz; dz<=rz; ++dz)
+        for( int dy=-ry; dy<=ry; ++dy)
+        for( int dx=-rx; dx<=rx; ++dx) {
+            const real d = static_cast<real>( dx*dx + dy*dy + dz*dz);
+            if( d <= eps_sq) {
+                StencilOffset offset = { dx, dy, dz, d };
+                ret.push_back( offset);
+            }
+        }
+        std::stable_sort( ret.begin(), ret.end(), []( const StencilOffset& a, const StencilOffset& b) { return a.distance < b.distance; });
+        return ret;
+    }
+
+
+    /** Retrieves the epsilon-neighborhood of a lattice point and its squared core distance in one pass
+     * over a stencil.
+     * @param lattice The lattice.
+     * @param p The point index.
+     * @param stencil The stencil of the epsilon-neighborhood, sorted by distance.
+     * @param min_pts The minimum number of points to be found within an epsilon-neigborhood.
+     * @param o_N_eps Receives all points within the epsilon-neighborhood of p, including p itself,
+     *        together with their squared distances to p. The previous content is cleared.
+     * @return The squared core distance of p, or OPTICS::UNDEFINED if p is no core point.
+     */
+    real get_lattice_neighbors( const Lattice& lattice,
+                                const std::uint32_t p,
+                                const std::vector<StencilOffset>& stencil,
+                                const unsigned int min_pts,
+                                std::vector<LatticeNeighbor>& o_N_eps) {
+        o_N_eps.clear();
+        unsigned int x, y, z;
+        lattice.coordinates( p, x, y, z);
+        const int w = static_cast<int>(lattice.width());
+        const int h = static_cast<int>(lattice.height());
+        const int d = static_cast<int>(lattice.depth());
+
+        real ret = OPTICS::UNDEFINED;
+        for( auto it=stencil.begin(); it!=stencil.end(); ++it) {
+            const int nx = static_cast<int>(x) + it->dx;
+            const int ny = static_cast<int>(y) + it->dy;
+            const int nz = static_cast<int>(z) + it->dz;
+            if( nx < 0 || ny < 0 || nz < 0 || nx >= w || ny >= h || nz >= d)
+                continue;
+
+            const std::size_t c = lattice.cell( nx, ny, nz);
+            if( !lattice.is_occupied( c))
+                continue;
+
+            LatticeNeighbor n = { lattice.point_at( c), it->distance };
+            o_N_eps.push_back( n);
+            if( o_N_eps.size() == min_pts+1)
+                ret = it->distance;
+        }
+        return ret;
+    }
+
+} // END namespace OPTICS
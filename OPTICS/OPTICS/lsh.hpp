@@ -0,0 +1,312 @@
+/******************************************************************************
+/* @file Contains a locality-sensitive hashing (LSH) index for approximate
+/*       range queries, which can be filled incrementally.
+/*
+/*
+/* @author langenhagen
+/* @version 261016
+/******************************************************************************/
+#pragma once
+
+///////////////////////////////////////////////////////////////////////////////
+// INCLUDES project headers
+
+#include "optics.hpp"
+
+///////////////////////////////////////////////////////////////////////////////
+//INCLUDES C/C++ standard library (and other external libraries)
+
+#include <algorithm> // sort, min, max
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+// NAMESPACE, CONSTANTS and TYPE DECLARATIONS/IMPLEMENTATIONS
+
+namespace OPTICS {
+
+    /// The distances of an LSHIndex.
+    enum LSHMetric {
+        LSH_EUCLIDEAN,  ///< The euclidean distance, hashed with p-stable projections.
+        LSH_COSINE      ///< The cosine distance 1 - cos(a,b), hashed with SimHash. Points with a norm of 0 have a cosine of 0 to all other points.
+    };
+
+
+    /** Implements a locality-sensitive hashing (LSH) index for approximate range queries.
+     * There are L hash tables, each keyed by the concatenation of k hash functions:
+     *  - for the euclidean distance, p-stable projections floor( (a.x + b) / w) with gaussian a;
+     *  - for the cosine distance, SimHash, i.e. the signs of projections a.x.
+     * Near points collide in a table with a high probability, far points with a low one. A query
+     * collects the points in its bucket of every table, plus, with multi-probing, in the buckets of
+     * the n_probes single hash perturbations that are most likely to hold near points, i.e. those
+     * whose projections of the query lie closest to a bucket boundary. The candidates are verified
+     * with the exact distance, so that the neighborhoods contain no false positives and exact distances.
+     * A point within eps is missed with a probability of at most miss_probability( eps) without
+     * multi-probing. This bounds single pairs only; it is no bound on the reachability plot.
+     * Missed neighbors can only raise core-distances, so these errors are one-sided. They also change
+     * the order of the expansion, so a point may be reached later from a closer core point, and its
+     * reachability-distance may come out lower as well as higher than the exact one.
+     * The errors shrink as k, L, w and n_probes are tuned for lower miss probabilities.
+     * Points are inserted one by one, in a single pass, and can be inserted at any time.
+     * Use it with optics_indexed(). The index keeps per-query scratch memory, so one index must not
+     * be queried concurrently.
+     */
+    class LSHIndex {
+
+    private: // types
+
+        /// A table, mapping keys to the indices of the points in the bucket.
+        typedef std::unordered_map<std::uint64_t, std::vector<std::uint32_t>> Table;
+
+    private: // vars
+
+        unsigned int _dim;                      ///< The dimensionality of the points.
+        LSHMetric _metric;                      ///< The metric.
+        real _bucket_width;                     ///< The bucket width w of the p-stable hashes.
+        unsigned int _n_tables;                 ///< The number L of tables.
+        unsigned int _n_hashes;                 ///< The number k of hash functions per table.
+        unsigned int _n_probes;                 ///< The number of additional buckets probed per table.
+        std::vector<real> _projections;         ///< The projection vectors a, _dim values per hash function, table after table.
+        std::vector<real> _offsets;             ///< The offsets b of the p-stable hashes, one per hash function.
+        std::vector<Table> _tables;             ///< The tables.
+        DataVector _points;                     ///< The indexed points, in insertion order.
+        std::vector<double> _norms;             ///< The euclidean norms of the points, for the cosine metric.
+        mutable std::vector<double> _values;    ///< Scratch memory: the hash values of the current point before rounding.
+        mutable std::vector<std::uint32_t> _visited; ///< Scratch memory: the stamp of the query that last visited a point.
+        mutable std::uint32_t _stamp;           ///< Scratch memory: the stamp of the current query.
+        mutable std::vector<std::pair<double, unsigned int>> _perturbations; ///< Scratch memory: the scored perturbations of a table.
+
+    public: // ctor & dtor
+
+        /** Main constructor. Creates an empty index.
+         * @param dim The dimensionality of the points.
+         * @param metric The metric.
+         * @param bucket_width The bucket width w of the p-stable hashes, in units of the distance.
+         *        About 2 to 4 times eps is a good choice. Ignored by the cosine metric.
+         * @param n_tables The number L of tables. More tables find more neighbors and cost memory and time.
+         * @param n_hashes The number k of hash functions per table, at most 64. More hashes make the buckets
+         *        smaller, i.e. produce fewer candidates and find fewer neighbors.
+         * @param n_probes The number of additional buckets probed per table, at most 2*k. More probes find
+         *        more neighbors with fewer tables.
+         * @param seed The seed of the hash functions.
+         */
+        LSHIndex( const unsigned int dim, const LSHMetric metric = LSH_EUCLIDEAN, const real bucket_width = 4, const unsigned int n_tables = 8, const unsigned int n_hashes = 8, const unsigned int n_probes = 0, const unsigned int seed = 42)
+            : _dim( dim), _metric( metric), _bucket_width( bucket_width), _n_tables( n_tables), _n_hashes( n_hashes),
+              _n_probes( std::min( n_probes, 2*n_hashes)), _tables( n_tables), _values( n_hashes), _stamp( 0) {
+            assert( bucket_width > 0 && "bucket_width must be greater than 0");
+            assert( n_tables > 0 && n_hashes > 0 && n_hashes <= 64 && "There must be at least one table and 1 to 64 hashes per table");
+            std::mt19937 generator( seed);
+            std::normal_distribution<double> gaussian( 0.0, 1.0);
+            std::uniform_real_distribution<double> uniform( 0.0, bucket_width);
+            _projections.resize( static_cast<std::size_t>( n_tables) * n_hashes * dim);
+            for( auto it=_projections.begin(); it!=_projections.end(); ++it)
+                *it = static_cast<real>( gaussian( generator));
+            _offsets.resize( static_cast<std::size_t>( n_tables) * n_hashes);
+            for( auto it=_offsets.begin(); it!=_offsets.end(); ++it)
+                *it = static_cast<real>( uniform( generator));
+        }
+
+    private: // forbidden copy construction and assignment
+
+        LSHIndex( const LSHIndex&);
+        LSHIndex& operator=( const LSHIndex&);
+
+    public: // methods
+
+        /** Retrieves the number of indexed points.
+         * @return The number of points.
+         */
+        inline std::size_t size() const { return _points.size(); }
+
+        /** Inserts a point. Takes O(L k dim).
+         * @param p The point. Must have the dimensionality of the index and outlive it.
+         */
+        void insert( DataPoint* p) {
+            assert( p->data().size() == _dim && "Point must have the dimensionality of the index");
+            const std::uint32_t idx = static_cast<std::uint32_t>( _points.size());
+            _points.push_back( p);
+            _norms.push_back( _metric == LSH_COSINE ? std::sqrt( dot( p->data().data(), p->data().data())) : 0.0);
+            _visited.push_back( 0);
+
+            for( unsigned int t=0; t<_n_tables; ++t) {
+                hash_values( p->data().data(), t);
+                _tables[t][key( -1)].push_back( idx);
+            }
+        }
+
+        /** Inserts points.
+         * @param db The points. Must have the dimensionality of the index and outlive it.
+         */
+        void insert( const DataVector& db) {
+            _points.reserve( _points.size() + db.size());
+            for( auto p_it=db.begin(); p_it!=db.end(); ++p_it)
+                insert( *p_it);
+        }
+
+        /** Retrieves indexed points within a given distance of a point, approximately.
+         * @param p The query point. Must have the dimensionality of the index.
+         * @param eps The radius of the query.
+         * @param o_N_eps Receives points within the radius around p, including p itself if it is indexed,
+         *        together with their squared distances to p. The previous content is kept.
+         */
+        void range_query( const DataPoint* p, const real eps, Neighborhood& o_N_eps) const {
+            assert( eps >= 0 && "eps must not be negative");
+            assert( p->data().size() == _dim && "Query point must have the dimensionality of the index");
+            const real* x = p->data().data();
+            const real eps_sq = eps*eps;
+            const double norm = _metric == LSH_COSINE ? std::sqrt( dot( x, x)) : 0.0;
+
+            if( ++_stamp == 0) {
+                std::fill( _visited.begin(), _visited.end(), 0);
+                _stamp = 1;
+            }
+
+            if( eps == OPTICS::UNDEFINED) {
+                for( std::uint32_t i=0; i<_points.size(); ++i)
+                    check( p, norm, i, eps_sq, o_N_eps);
+                return;
+            }
+
+            for( unsigned int t=0; t<_n_tables; ++t) {
+                hash_values( x, t);
+                probe( _tables[t], key( -1), p, norm, eps_sq, o_N_eps);
+                if( _n_probes == 0)
+                    continue;
+
+                // score the perturbations of single hashes by the distance of the value to the bucket boundary
+                _perturbations.clear();
+                for( unsigned int i=0; i<_n_hashes; ++i) {
+                    if( _metric == LSH_COSINE) {
+                        _perturbations.push_back( std::make_pair( std::abs( _values[i]), i));
+                    } else {
+                        const double fraction = _values[i] - std::floor( _values[i]);
+                        _perturbations.push_back( std::make_pair( fraction, 2*i));
+                        _perturbations.push_back( std::make_pair( 1 - fraction, 2*i+1));
+                    }
+                }
+                const std::size_t n_probes = std::min<std::size_t>( _n_probes, _perturbations.size());
+                std::partial_sort( _perturbations.begin(), _perturbations.begin() + n_probes, _perturbations.end());
+                for( std::size_t j=0; j<n_probes; ++j)
+                    probe( _tables[t], key( _perturbations[j].second), p, norm, eps_sq, o_N_eps);
+            }
+        }
+
+        /** Retrieves the probability that a point at a given distance is missed by a query without
+         * multi-probing: (1 - p^k)^L, with the collision probability p of a single hash function.
+         * This is a per-pair probability, not a bound on the errors of core or reachability distances.
+         * @param distance The distance, not squared.
+         * @return The miss probability.
+         */
+        double miss_probability( const real distance) const {
+            double p;
+            if( _metric == LSH_COSINE) {
+                // *** the angle of two points with cosine distance d is acos(1-d) ***
+                const double cosine = std::max( -1.0, std::min( 1.0, 1.0 - distance));
+                p = 1.0 - std::acos( cosine) / std::acos( -1.0);
+            } else if( distance <= 0) {
+                p = 1.0;
+            } else {
+                const double r = _bucket_width / distance;
+                const double pi = std::acos( -1.0);
+                p = std::erf( r / std::sqrt( 2.0)) - 2.0 / (std::sqrt( 2*pi) * r) * (1.0 - std::exp( -r*r / 2));
+            }
+            return std::pow( 1.0 - std::pow( p, static_cast<double>( _n_hashes)), static_cast<double>( _n_tables));
+        }
+
+    private: // helpers
+
+        /** Computes the hash values of a position for a table, before rounding, into _values.
+         * @param x The coordinates of the position.
+         * @param t The table.
+         */
+        void hash_values( const real* x, const unsigned int t) const {
+            for( unsigned int i=0; i<_n_hashes; ++i) {
+                const std::size_t h = static_cast<std::size_t>( t) * _n_hashes + i;
+                const double projection = dot( &_projections[h * _dim], x);
+                _values[i] = _metric == LSH_COSINE ? projection : (projection + _offsets[h]) / _bucket_width;
+            }
+        }
+
+        /** Combines the rounded hash values in _values into the key of a bucket.
+         * @param perturbation The perturbation to apply, or -1 for none. For the cosine metric, perturbation i
+         *        flips hash i; for the euclidean metric, perturbation 2i decrements and 2i+1 increments hash i.
+         * @return The key.
+         */
+        std::uint64_t key( const int perturbation) const {
+            std::uint64_t ret = 14695981039346656037ull;
+            for( unsigned int i=0; i<_n_hashes; ++i) {
+                std::int64_t h = _metric == LSH_COSINE ? (_values[i] >= 0 ? 1 : 0) : static_cast<std::int64_t>( std::floor( _values[i]));
+                if( perturbation >= 0) {
+                    if( _metric == LSH_COSINE && static_cast<unsigned int>( perturbation) == i)
+                        h = 1 - h;
+                    else if( _metric == LSH_EUCLIDEAN && static_cast<unsigned int>( perturbation) / 2 == i)
+                        h += perturbation % 2 == 0 ? -1 : 1;
+                }
+                ret = (ret ^ static_cast<std::uint64_t>( h)) * 1099511628211ull;
+            }
+            return ret;
+        }
+
+        /** Verifies the points of a bucket that were not visited by the current query yet.
+         * @param table The table.
+         * @param k The key of the bucket.
+         * @param p The query point.
+         * @param norm The norm of the query point, for the cosine metric.
+         * @param eps_sq The squared radius of the query.
+         * @param o_N_eps The neighborhood to extend.
+         */
+        inline void probe( const Table& table, const std::uint64_t k, const DataPoint* p, const double norm, const real eps_sq, Neighborhood& o_N_eps) const {
+            auto bucket_it = table.find( k);
+            if( bucket_it == table.end())
+                return;
+            for( auto it=bucket_it->second.begin(); it!=bucket_it->second.end(); ++it)
+                check( p, norm, *it, eps_sq, o_N_eps);
+        }
+
+        /** Adds an indexed point to a neighborhood if it was not visited by the current query yet
+         * and is within the query radius.
+         * @param p The query point.
+         * @param norm The norm of the query point, for the cosine metric.
+         * @param idx The index of the point.
+         * @param eps_sq The squared radius of the query.
+         * @param o_N_eps The neighborhood to extend.
+         */
+        inline void check( const DataPoint* p, const double norm, const std::uint32_t idx, const real eps_sq, Neighborhood& o_N_eps) const {
+            if( _visited[idx] == _stamp)
+                return;
+            _visited[idx] = _stamp;
+
+            DataPoint* q = _points[idx];
+            real d;
+            if( _metric == LSH_COSINE) {
+                const double norms = norm * _norms[idx];
+                const double cosine = q == p ? 1.0 : norms > 0 ? dot( p->data().data(), q->data().data()) / norms : 0.0;
+                const double distance = std::max( 0.0, 1.0 - cosine);
+                d = static_cast<real>( distance*distance);
+            } else {
+                d = squared_distance( p, q);
+            }
+            if( d <= eps_sq) {
+                Neighbor n = { q, d };
+                o_N_eps.push_back( n);
+            }
+        }
+
+        /** Computes the dot product of two vectors of the index's dimensionality.
+         * @param a The first vector.
+         * @param b The second vector.
+         * @return The dot product.
+         */
+        inline double dot( const real* a, const real* b) const {
+            double ret = 0;
+            for( unsigned int k=0; k<_dim; ++k)
+                ret += static_cast<double>( a[k]) * b[k];
+            return ret;
+        }
+    };
+
+} // END namespace OPTICS
@@ -0,0 +1,211 @@
+/******************************************************************************
+/* @file Contains the Mahalanobis distance in the form of a whitening transform
+/*       that is applied to the points once, before clustering.
+/*
+/*
+/* @author langenhagen
+/* @version 261016
+/******************************************************************************/
+#pragma once
+
+///////////////////////////////////////////////////////////////////////////////
+// INCLUDES project headers
+
+#include "DataPoint.hpp"
+
+///////////////////////////////////////////////////////////////////////////////
+//INCLUDES C/C++ standard library (and other external libraries)
+
+#include <cmath>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+// NAMESPACE, CONSTANTS and TYPE DECLARATIONS/IMPLEMENTATIONS
+
+namespace OPTICS {
+
+    // FUNCTION DECLARATIONS ######################################################################
+
+    std::vector<double> estimate_covariance( const DataVector& db);
+    bool cholesky( const std::vector<double>& matrix, const unsigned int dim, std::vector<double>& o_factor);
+
+
+
+    /** Implements the Mahalanobis distance sqrt( (x-y)^T S^-1 (x-y) ) with a covariance matrix S
+     * as a whitening transform of the points.
+     * With the Cholesky factorization S = L L^T, the Mahalanobis distance of x and y equals the
+     * euclidean distance of L^-1 x and L^-1 y. The transform thus maps the data elements of all
+     * points once, in O(n dim^2), after which optics(), the KDTree and all other parts of the
+     * OPTICS module run their euclidean kernels unchanged, with eps in Mahalanobis units.
+     * Usage:
+     *     Whitening whitening( estimate_covariance( db), dim);
+     *     whitening.apply( db);
+     *     DataVector ordering = optics( db, eps, min_pts);
+     *     whitening.revert( db); // optional
+     */
+    class Whitening {
+
+    private: // vars
+
+        unsigned int _dim;              ///< The dimensionality of the points.
+        std::vector<double> _factor;    ///< The lower triangular Cholesky factor L of the covariance matrix, row-major.
+        bool _is_valid;                 ///< Whether the covariance matrix is positive definite.
+
+    public: // ctor & dtor
+
+        /** Main constructor. Computes the Cholesky factorization of the covariance matrix in O(dim^3).
+         * @param covariance The symmetric covariance matrix, dim*dim values in row-major order.
+         * @param dim The dimensionality of the points.
+         * @param ridge A value added to the diagonal of the covariance matrix, e.g. to regularize
+         *        the estimated covariance of data that lies in a subspace.
+         */
+        Whitening( const std::vector<double>& covariance, const unsigned int dim, const double ridge = 0)
+            : _dim( dim) {
+            assert( covariance.size() == static_cast<std::size_t>( dim)*dim && "The covariance matrix must have dim*dim elements");
+            std::vector<double> regularized( covariance);
+            for( unsigned int i=0; i<dim; ++i)
+                regularized[i*dim + i] += ridge;
+            _is_valid = cholesky( regularized, dim, _factor);
+        }
+
+    public: // methods
+
+        /** Retrieves whether the covariance matrix is positive definite, i.e. whether the transform exists.
+         * @return true if the transform can be applied, false otherwise.
+         */
+        inline bool is_valid() const { return _is_valid; }
+
+        /** Retrieves the dimensionality of the points.
+         * @return The dimensionality of the points.
+         */
+        inline unsigned int dim() const { return _dim; }
+
+        /** Transforms the data elements of all points in place, so that euclidean distances between
+         * them equal the Mahalanobis distances between the original points.
+         * @param db The points to transform. Their dimensionality must be dim().
+         */
+        void apply( DataVector& db) const {
+            assert( _is_valid && "The covariance matrix must be positive definite");
+            std::vector<double> z( _dim);
+            for( auto p_it=db.begin(); p_it!=db.end(); ++p_it) {
+                RealVector& x = (*p_it)->data();
+                assert( x.size() == _dim && "The points must have the dimensionality of the covariance matrix");
+
+                // forward substitution solves L z = x
+                for( unsigned int i=0; i<_dim; ++i) {
+                    const double* row = &_factor[i*_dim];
+                    double sum = x[i];
+                    for( unsigned int k=0; k<i; ++k)
+                        sum -= row[k] * z[k];
+                    z[i] = sum / row[i];
+                }
+                for( unsigned int i=0; i<_dim; ++i)
+                    x[i] = static_cast<real>( z[i]);
+            }
+        }
+
+        /** Undoes apply(), restoring the original data elements up to rounding.
+         * @param db The points to transform back. Their dimensionality must be dim().
+         */
+        void revert( DataVector& db) const {
+            assert( _is_valid && "The covariance matrix must be positive definite");
+            std::vector<double> x( _dim);
+            for( auto p_it=db.begin(); p_it!=db.end(); ++p_it) {
+                RealVector& z = (*p_it)->data();
+                assert( z.size() == _dim && "The points must have the dimensionality of the covariance matrix");
+
+                // x = L z
+                for( unsigned int i=0; i<_dim; ++i) {
+                    const double* row = &_factor[i*_dim];
+                    double sum = 0;
+                    for( unsigned int k=0; k<=i; ++k)
+                        sum += row[k] * z[k];
+                    x[i] = sum;
+                }
+                for( unsigned int i=0; i<_dim; ++i)
+                    z[i] = static_cast<real>( x[i]);
+            }
+        }
+    };
+
+
+
+    // FUNCTIONS ##################################################################################
+
+
+    /** Estimates the covariance matrix of a set of points.
+     * Subtracts the mean before accumulating the outer products, which keeps the estimate accurate
+     * for data far from the origin, and accumulates only the lower triangle.
+     * @param db The points. All points must have the same dimensionality.
+     * @return The sample covariance matrix, dim*dim values in row-major order.
+     *         Empty if db is empty.
+     */
+    std::vector<double> estimate_covariance( const DataVector& db) {
+        if( db.empty())
+            return std::vector<double>();
+        const std::size_t dim = db.front()->data().size();
+        const std::size_t n = db.size();
+
+        std::vector<double> mean( dim, 0.0);
+        for( auto p_it=db.begin(); p_it!=db.end(); ++p_it) {
+            const RealVector& x = (*p_it)->data();
+            assert( x.size() == dim && "All points must have the same dimensionality");
+            for( std::size_t i=0; i<dim; ++i)
+                mean[i] += x[i];
+        }
+        for( std::size_t i=0; i<dim; ++i)
+            mean[i] /= n;
+
+        std::vector<double> ret( dim*dim, 0.0);
+        std::vector<double> centered( dim);
+        for( auto p_it=db.begin(); p_it!=db.end(); ++p_it) {
+            const RealVector& x = (*p_it)->data();
+            for( std::size_t i=0; i<dim; ++i)
+                centered[i] = x[i] - mean[i];
+            for( std::size_t i=0; i<dim; ++i) {
+                double* row = &ret[i*dim];
+                const double c = centered[i];
+                for( std::size_t k=0; k<=i; ++k)
+                    row[k] += c * centered[k];
+            }
+        }
+
+        const double normalizer = n > 1 ? 1.0 / (n - 1) : 1.0;
+        for( std::size_t i=0; i<dim; ++i) {
+            for( std::size_t k=0; k<=i; ++k) {
+                ret[i*dim + k] *= normalizer;
+                ret[k*dim + i] = ret[i*dim + k];
+            }
+        }
+        return ret;
+    }
+
+
+    /** Computes the Cholesky factorization A = L L^T of a symmetric positive definite matrix.
+     * @param matrix The matrix A, dim*dim values in row-major order. Only the lower triangle is read.
+     * @param dim The number of rows and columns.
+     * @param o_factor Receives the lower triangular factor L, dim*dim values in row-major order
+     *        with zeros above the diagonal.
+     * @return true if the matrix is positive definite, false otherwise.
+     */
+    bool cholesky( const std::vector<double>& matrix, const unsigned int dim, std::vector<double>& o_factor) {
+        o_factor.assign( static_cast<std::size_t>( dim)*dim, 0.0);
+        for( unsigned int i=0; i<dim; ++i) {
+            for( unsigned int j=0; j<=i; ++j) {
+                double sum = matrix[i*dim + j];
+                for( unsigned int k=0; k<j; ++k)
+                    sum -= o_factor[i*dim + k] * o_factor[j*dim + k];
+
+                if( i == j) {
+                    if( !(sum > 0))
+                        return false;
+                    o_factor[i*dim + i] = std::sqrt( sum);
+                } else {
+                    o_factor[i*dim + j] = sum / o_factor[j*dim + j];
+                }
+            }
+        }
+        return true;
+    }
+
+} // END namespace OPTICS
@@ -13,7 +13,7 @@
 /*
 /*
 /* @author langenhagen
-/* @version 150605
+/* @version 261016
 /******************************************************************************/
 #pragma once
 
@@ -21,11 +21,15 @@
 // INCLUDES project headers
 
 #include "DataPoint.hpp"
+#include "kdtree.hpp"
+#include "thread_pool.hpp"
+#include "workspace.hpp"
 
 ///////////////////////////////////////////////////////////////////////////////
 //INCLUDES C/C++ standard library (and other external libraries)
 
-#include <algorithm> // nth_element
+#include <algorithm> // nth_element, upper_bound, make_heap, push_heap, pop_heap
+#include <cstdint>
 #include <functional>
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -41,7 +45,9 @@ namespace OPTICS {
 
     // non-callback version
     DataVector optics( DataVector& db, const real eps, const unsigned int min_pts);
+    DataVector optics( DataVector& db, const real eps, const unsigned int min_pts, Workspace& ws);
     void expand_cluster_order( DataVector& db, DataPoint* p, const real eps, const unsigned int min_pts, DataVector& o_ordered_vector);
+    void expand_cluster_order( DataVector& db, DataPoint* p, const real eps, const unsigned int min_pts, DataVector& o_ordered_vector, Workspace& ws);
     
     // callback version
     DataVector optics( DataVector& db, 
@@ -54,14 +60,44 @@ namespace OPTICS {
                                const unsigned int min_pts, 
                                DataVector& o_ordered_vector, 
                                std::function<void(const DataPoint* p)> point_processed_callback);
+    void expand_cluster_order( DataVector& db, 
+                               DataPoint* p, 
+                               const real eps, 
+                               const unsigned int min_pts, 
+                               DataVector& o_ordered_vector, 
+                               Workspace& ws,
+                               std::function<void(const DataPoint* p)> point_processed_callback);
     
+    // unbounded-eps version
+    DataVector optics_unbounded( DataVector& db, 
+                                 const unsigned int min_pts, 
+                                 std::function<void(const DataPoint* p)> point_processed_callback = nullptr,
+                                 ThreadPool& pool = default_pool());
+
+    // index version
+    template<typename Index>
+    DataVector optics_indexed( DataVector& db, const Index& index, const real eps, const unsigned int min_pts);
+    template<typename Index>
+    void expand_cluster_order_indexed( const Index& index, DataPoint* p, const real eps, const unsigned int min_pts, DataVector& o_ordered_vector, Workspace& ws);
+
     // utility functions
     std::vector<DataVector> extract_clusters( const DataVector& result, const std::vector<unsigned int>& cluster_borders, real outlier_threshold);
+    std::vector<int> extract_dbscan( const DataVector& result, const real eps_prime);
+    std::vector<std::vector<int>> extract_dbscan( const DataVector& result, const std::vector<real>& eps_primes);
+    void extract_cluster_labels( const DataVector& result, 
+                                 const std::vector<unsigned int>& cluster_borders, 
+                                 real outlier_threshold, 
+                                 std::int32_t* o_labels, 
+                                 ThreadPool& pool = default_pool());
+    std::vector<ClusterSpan> cluster_spans( const DataVector& result, const std::vector<unsigned int>& cluster_borders);
 
     // helpers
     void update_seeds( const DataVector& N_eps, const DataPoint* center_object, const real c_dist, DataSet& o_seeds);
+    void update_seeds( const Neighborhood& N_eps, const real c_dist, SeedHeap& o_seeds);
     DataVector get_neighbors( const DataPoint* p, const real eps, DataVector& db);
+    real get_neighbors( const DataPoint* p, const real eps, const unsigned int min_pts, DataVector& db, Neighborhood& o_N_eps, RealVector& heap);
     real squared_core_distance( const DataPoint* p, const unsigned int min_pts, DataVector& N_eps);
+    real squared_core_distance( const Neighborhood& N_eps, const unsigned int min_pts, RealVector& buffer);
     real squared_distance( const DataPoint* a, const DataPoint* b);
     
 
@@ -72,13 +108,32 @@ namespace OPTICS {
     /** Performs the classic OPTICS algorithm.
      * @param db All data points that are to be considered by the algorithm. Changes their values.
      * @param eps The epsilon representing the radius of the epsilon-neighborhood.
+     *        If set to OPTICS::UNDEFINED, the work is delegated to optics_unbounded() on the calling thread.
      * @param min_pts The minimum number of points to be found within an epsilon-neigborhood.
-     * @return Return the OPTICS ordered list of Data points with reachability-distances set.
+     * @return Return the OPTICS ordered list of Data points with reachability-distances and core-distances set.
      */
     DataVector optics( DataVector& db, const real eps, const unsigned int min_pts) {
+        Workspace ws;
+        return optics( db, eps, min_pts, ws);
+    }
+
+
+    /** Performs the classic OPTICS algorithm on a given workspace.
+     * @param db All data points that are to be considered by the algorithm. Changes their values.
+     * @param eps The epsilon representing the radius of the epsilon-neighborhood.
+     *        If set to OPTICS::UNDEFINED, the work is delegated to optics_unbounded() on the calling thread.
+     * @param min_pts The minimum number of points to be found within an epsilon-neigborhood.
+     * @param ws The scratch memory of the run. Can be reused across runs.
+     * @return Return the OPTICS ordered list of Data points with reachability-distances and core-distances set.
+     *         The list uses the allocator of db.
+     */
+    DataVector optics( DataVector& db, const real eps, const unsigned int min_pts, Workspace& ws) {
         assert( eps >= 0 && "eps must not be negative");
         assert( min_pts > 0 && "min_pts must be greater than 0");
-        DataVector ret;
+        if( eps == OPTICS::UNDEFINED)
+            return optics_unbounded( db, min_pts, nullptr, serial_pool());
+        DataVector ret( db.get_allocator());
+        ret.reserve( db.size());
 
         for( auto p_it = db.begin(); p_it != db.end(); ++p_it) {
             DataPoint* p = *p_it;
@@ -86,7 +141,7 @@ namespace OPTICS {
             if( p->is_processed())
                 continue;
             
-            expand_cluster_order( db, p, eps, min_pts, ret);
+            expand_cluster_order( db, p, eps, min_pts, ret, ws);
         }
         return ret;
     }
@@ -100,32 +155,47 @@ namespace OPTICS {
      * @param o_ordered_vector The ordered vector of data points. Elements will be added to this vector.
      */
     void expand_cluster_order( DataVector& db, DataPoint* p, const real eps, const unsigned int min_pts, DataVector& o_ordered_vector) {
+        Workspace ws;
+        expand_cluster_order( db, p, eps, min_pts, o_ordered_vector, ws);
+    }
+
+
+    /** Expands the cluster order while adding new neighbor points to the order.
+     * All scratch memory is taken from the given workspace, so that no allocation happens
+     * once the workspace buffers have grown to their working size.
+     * @param db All data points that are to be considered by the algorithm. Changes their values.
+     * @param p The point to be examined.
+     * @param eps The epsilon representing the radius of the epsilon-neighborhood.
+     * @param min_pts The minimum number of points to be found within an epsilon-neigborhood.
+     * @param o_ordered_vector The ordered vector of data points. Elements will be added to this vector.
+     * @param ws The scratch memory of the run.
+     */
+    void expand_cluster_order( DataVector& db, DataPoint* p, const real eps, const unsigned int min_pts, DataVector& o_ordered_vector, Workspace& ws) {
         assert( eps >= 0 && "eps must not be negative");
         assert( min_pts > 0 && "min_pts must be greater than 0");
         
-        DataVector N_eps = get_neighbors( p, eps, db);
+        Neighborhood& N_eps = ws.neighbors;
         p->reachability_distance( OPTICS::UNDEFINED);
-        const real core_dist_p = squared_core_distance( p, min_pts, N_eps);
+        const real core_dist_p = get_neighbors( p, eps, min_pts, db, N_eps, ws.core_heap);
+        p->core_distance( core_dist_p);
         p->processed( true);
         o_ordered_vector.push_back( p);
     
         if( core_dist_p == OPTICS::UNDEFINED)
             return;
 
-        DataSet seeds;
-        update_seeds( N_eps, p, core_dist_p, seeds);
+        SeedHeap& seeds = ws.seeds;
+        seeds.clear();
+        update_seeds( N_eps, core_dist_p, seeds);
         
-        while( !seeds.empty()) {
-            DataPoint* q = *seeds.begin();
-            seeds.erase( seeds.begin()); // remove first element from seeds
-
-            DataVector N_q = get_neighbors( q, eps, db);
-            const real core_dist_q = squared_core_distance( q, min_pts, N_q);
+        while( DataPoint* q = seeds.pop()) {
+            const real core_dist_q = get_neighbors( q, eps, min_pts, db, N_eps, ws.core_heap);
+            q->core_distance( core_dist_q);
             q->processed( true);
             o_ordered_vector.push_back( q);
             if( core_dist_q != OPTICS::UNDEFINED) {
                 // *** q is a core-object ***
-                update_seeds( N_q, q, core_dist_q, seeds);
+                update_seeds( N_eps, core_dist_q, seeds);
             }
         }
     }
@@ -140,10 +210,11 @@ namespace OPTICS {
      * a callback function informs you when a new point is inserted into the OPTICS ordering.
      * @param db All data points that are to be considered by the algorithm. Changes their values.
      * @param eps The epsilon representing the radius of the epsilon-neighborhood.
+     *        If set to OPTICS::UNDEFINED, the work is delegated to optics_unbounded() on the calling thread.
      * @param min_pts The minimum number of points to be found within an epsilon-neigborhood.
      * @param point_processed_callback Callback function that is called when one point is 
      *        added to the ordered output list. It takes the pointer to the data point as an argument.
-     * @return Return the OPTICS ordered list of Data points with reachability-distances set.
+     * @return Return the OPTICS ordered list of Data points with reachability-distances and core-distances set.
      */
     DataVector optics( DataVector& db, 
                        const real eps, 
@@ -151,7 +222,11 @@ namespace OPTICS {
                        std::function<void(const DataPoint* p)> point_processed_callback) {
         assert( eps >= 0 && "eps must not be negative");
         assert( min_pts > 0 && "min_pts must be greater than 0");
-        DataVector ret;
+        if( eps == OPTICS::UNDEFINED)
+            return optics_unbounded( db, min_pts, point_processed_callback, serial_pool());
+        DataVector ret( db.get_allocator());
+        ret.reserve( db.size());
+        Workspace ws;
 
         for( auto p_it = db.begin(); p_it != db.end(); ++p_it) {
             DataPoint* p = *p_it;
@@ -159,7 +234,7 @@ namespace OPTICS {
             if( p->is_processed())
                 continue;
             
-            expand_cluster_order( db, p, eps, min_pts, ret, point_processed_callback);
+            expand_cluster_order( db, p, eps, min_pts, ret, ws, point_processed_callback);
         }
         return ret;
     }
@@ -182,12 +257,39 @@ namespace OPTICS {
                                const unsigned int min_pts,
                                DataVector& o_ordered_vector,
                                std::function<void(const DataPoint* p)> point_processed_callback) {
+        Workspace ws;
+        expand_cluster_order( db, p, eps, min_pts, o_ordered_vector, ws, point_processed_callback);
+    }
+
+
+    /** Expands the cluster order while adding new neighbor points to the order.
+     * Because OPTICS can take a while on big data sets or when working with high dimensions,
+     * a callback function informs you when a new point is inserted into the OPTICS ordering.
+     * All scratch memory is taken from the given workspace, so that no allocation happens
+     * once the workspace buffers have grown to their working size.
+     * @param db All data points that are to be considered by the algorithm. Changes their values.
+     * @param p The point to be examined.
+     * @param eps The epsilon representing the radius of the epsilon-neighborhood.
+     * @param min_pts The minimum number of points to be found within an epsilon-neigborhood.
+     * @param o_ordered_vector The ordered vector of data points. Elements will be added to this vector.
+     * @param ws The scratch memory of the run.
+     * @param point_processed_callback Callback function that is called when one point is 
+     *        added to the ordered output list. It takes the pointer to the data point as an argument.
+     */
+    void expand_cluster_order( DataVector& db,
+                               DataPoint* p, 
+                               const real eps,
+                               const unsigned int min_pts,
+                               DataVector& o_ordered_vector,
+                               Workspace& ws,
+                               std::function<void(const DataPoint* p)> point_processed_callback) {
         assert( eps >= 0 && "eps must not be negative");
         assert( min_pts > 0 && "min_pts must be greater than 0");
         
-        DataVector N_eps = get_neighbors( p, eps, db);
+        Neighborhood& N_eps = ws.neighbors;
         p->reachability_distance( OPTICS::UNDEFINED);
-        const real core_dist_p = squared_core_distance( p, min_pts, N_eps);
+        const real core_dist_p = get_neighbors( p, eps, min_pts, db, N_eps, ws.core_heap);
+        p->core_distance( core_dist_p);
         p->processed( true);
         o_ordered_vector.push_back( p);
         point_processed_callback( p);
@@ -195,26 +297,227 @@ namespace OPTICS {
         if( core_dist_p == OPTICS::UNDEFINED)
             return;
 
-        DataSet seeds;
-        update_seeds( N_eps, p, core_dist_p, seeds);
+        SeedHeap& seeds = ws.seeds;
+        seeds.clear();
+        update_seeds( N_eps, core_dist_p, seeds);
         
-        while( !seeds.empty()) {
-            DataPoint* q = *seeds.begin();
-            seeds.erase( seeds.begin()); // remove first element from seeds
-
-            DataVector N_q = get_neighbors( q, eps, db);
-            const real core_dist_q = squared_core_distance( q, min_pts, N_q);
+        while( DataPoint* q = seeds.pop()) {
+            const real core_dist_q = get_neighbors( q, eps, min_pts, db, N_eps, ws.core_heap);
+            q->core_distance( core_dist_q);
             q->processed( true);
             o_ordered_vector.push_back( q);
-            point_processed_callback( p);
+            point_processed_callback( q);
             if( core_dist_q != OPTICS::UNDEFINED) {
                 // *** q is a core-object ***
-                update_seeds( N_q, q, core_dist_q, seeds);
+                update_seeds( N_eps, core_dist_q, seeds);
             }
         }
     }
 
 
+
+    // UNBOUNDED-EPS VERSION ######################################################################
+
+
+    /** Performs the OPTICS algorithm with an infinite epsilon.
+     * With an infinite epsilon, every epsilon-neighborhood is the whole database. Instead of
+     * materializing these neighborhoods, the core distances are found by k-nearest neighbor queries
+     * on a KDTree and the ordering is built like Prim's minimum spanning tree over the mutual
+     * reachability graph, driven by the same tree: every processed point proposes its nearest
+     * unprocessed point under the mutual reachability distance, and a heap of these proposals yields
+     * the next point. When the proposal of a point is taken, the point proposes its next nearest
+     * unprocessed point. Subtrees of processed points are pruned, so each step costs a few tree
+     * queries instead of a pass over all points. This needs O(n) memory. The result equals the
+     * result of the classic algorithm with eps = OPTICS::UNDEFINED.
+     * @param db All data points that are to be considered by the algorithm. Changes their values.
+     * @param min_pts The minimum number of points to be found within an epsilon-neigborhood.
+     * @param point_processed_callback Callback function that is called when one point is 
+     *        added to the ordered output list. It takes the pointer to the data point as an argument.
+     *        Can be nullptr.
+     * @param pool The thread pool that builds the KDTree and finds the core distances.
+     *        Pass serial_pool() to run everything on the calling thread.
+     * @return Return the OPTICS ordered list of Data points with reachability-distances and core-distances set.
+     */
+    DataVector optics_unbounded( DataVector& db, 
+                                 const unsigned int min_pts, 
+                                 std::function<void(const DataPoint* p)> point_processed_callback,
+                                 ThreadPool& pool) {
+        assert( min_pts > 0 && "min_pts must be greater than 0");
+        DataVector ret( db.get_allocator());
+        ret.reserve( db.size());
+
+        DataVector unprocessed( db.get_allocator());
+        for( auto p_it=db.begin(); p_it!=db.end(); ++p_it) {
+            if( !(*p_it)->is_processed())
+                unprocessed.push_back( *p_it);
+        }
+        if( unprocessed.empty())
+            return ret;
+
+        for( auto p_it=unprocessed.begin(); p_it!=unprocessed.end(); ++p_it)
+            (*p_it)->reachability_distance( OPTICS::UNDEFINED);
+
+        if( db.size() <= min_pts) {
+            // *** no core points at all, every point starts a cluster order of its own ***
+            for( auto p_it=unprocessed.begin(); p_it!=unprocessed.end(); ++p_it) {
+                DataPoint* p = *p_it;
+                p->core_distance( OPTICS::UNDEFINED);
+                p->processed( true);
+                ret.push_back( p);
+                if( point_processed_callback)
+                    point_processed_callback( p);
+            }
+            return ret;
+        }
+
+        // find the core distances
+        const KDTree tree( db, 16, pool);
+        pool.parallel_for( 0, unprocessed.size(), 256, [&]( const std::size_t lower_idx, const std::size_t upper_idx) {
+            std::vector<real> heap;
+            for( std::size_t i=lower_idx; i<upper_idx; ++i)
+                unprocessed[i]->core_distance( tree.kth_nearest_distance( unprocessed[i], min_pts+1, heap));
+        });
+
+        // build the ordering, starting at the first unprocessed point
+        struct Proposal {
+            real reachability_distance; ///< The mutual reachability distance between both points.
+            DataPoint* point;           ///< The proposed point. Breaks ties like Comp_DataPoint_Ptr_f.
+            unsigned int target;        ///< The position of the proposed point in the tree.
+            unsigned int source;        ///< The position of the proposing point in the tree.
+        };
+        auto worse = []( const Proposal& a, const Proposal& b) {
+            return a.reachability_distance > b.reachability_distance
+                || (a.reachability_distance == b.reachability_distance && a.point > b.point);
+        };
+        std::vector<unsigned int> n_unprocessed;
+        tree.count_unprocessed( n_unprocessed);
+        std::vector<Proposal> proposals; // at most one per processed point, the best on top
+
+        auto propose = [&]( const unsigned int source) {
+            Proposal proposal;
+            const int target = tree.nearest_unprocessed( source, tree.point( source)->core_distance(), n_unprocessed, proposal.reachability_distance);
+            if( target < 0)
+                return;
+            proposal.point = tree.point( target);
+            proposal.target = static_cast<unsigned int>( target);
+            proposal.source = source;
+            proposals.push_back( proposal);
+            std::push_heap( proposals.begin(), proposals.end(), worse);
+        };
+        auto visit = [&]( const unsigned int position) {
+            DataPoint* q = tree.point( position);
+            q->processed( true);
+            ret.push_back( q);
+            if( point_processed_callback)
+                point_processed_callback( q);
+            tree.remove_unprocessed( position, n_unprocessed);
+            // *** q is a core-object ***
+            propose( position);
+        };
+
+        unsigned int start = 0;
+        while( tree.point( start) != unprocessed.front())
+            ++start;
+        visit( start);
+        while( !proposals.empty()) {
+            const Proposal proposal = proposals.front();
+            std::pop_heap( proposals.begin(), proposals.end(), worse);
+            proposals.pop_back();
+
+            if( !proposal.point->is_processed()) {
+                proposal.point->reachability_distance( proposal.reachability_distance);
+                visit( proposal.target);
+            }
+            // *** the proposal is taken or outdated ***
+            propose( proposal.source);
+        }
+        assert( ret.size() == unprocessed.size() && "Every point is reachable with an infinite epsilon");
+        return ret;
+    }
+
+
+
+
+    // INDEX VERSION ##############################################################################
+
+
+    /** Performs the classic OPTICS algorithm with the epsilon-neighborhoods retrieved from an index.
+     * The index decides how points are compared: it may use a spatial data structure like the KDTree,
+     * or represent points that are not dense vectors at all. The DataPoints only carry the state of
+     * the algorithm then, and their data vectors can be empty.
+     * An index must provide the method
+     *     void range_query( const DataPoint* p, const real eps, Neighborhood& o_N_eps) const;
+     * which appends all points within distance eps of p, including p itself, together with their
+     * squared distances to p.
+     * @param db All data points that are to be considered by the algorithm. Changes their values.
+     *        Must be the points known to the index.
+     * @param index The index over db.
+     * @param eps The epsilon representing the radius of the epsilon-neighborhood.
+     * @param min_pts The minimum number of points to be found within an epsilon-neigborhood.
+     * @return Return the OPTICS ordered list of Data points with reachability-distances and core-distances set.
+     */
+    template<typename Index>
+    DataVector optics_indexed( DataVector& db, const Index& index, const real eps, const unsigned int min_pts) {
+        assert( eps >= 0 && "eps must not be negative");
+        assert( min_pts > 0 && "min_pts must be greater than 0");
+        DataVector ret( db.get_allocator());
+        ret.reserve( db.size());
+        Workspace ws;
+
+        for( auto p_it = db.begin(); p_it != db.end(); ++p_it) {
+            DataPoint* p = *p_it;
+
+            if( p->is_processed())
+                continue;
+
+            expand_cluster_order_indexed( index, p, eps, min_pts, ret, ws);
+        }
+        return ret;
+    }
+
+
+    /** Expands the cluster order while adding new neighbor points to the order,
+     * with the epsilon-neighborhoods retrieved from an index.
+     * @param index The index over all data points that are to be considered by the algorithm.
+     * @param p The point to be examined.
+     * @param eps The epsilon representing the radius of the epsilon-neighborhood.
+     * @param min_pts The minimum number of points to be found within an epsilon-neigborhood.
+     * @param o_ordered_vector The ordered vector of data points. Elements will be added to this vector.
+     * @param ws The scratch memory of the run.
+     * @see optics_indexed()
+     */
+    template<typename Index>
+    void expand_cluster_order_indexed( const Index& index, DataPoint* p, const real eps, const unsigned int min_pts, DataVector& o_ordered_vector, Workspace& ws) {
+        Neighborhood& N_eps = ws.neighbors;
+        N_eps.clear();
+        index.range_query( p, eps, N_eps);
+        const real core_dist_p = squared_core_distance( N_eps, min_pts, ws.core_heap);
+        p->reachability_distance( OPTICS::UNDEFINED);
+        p->core_distance( core_dist_p);
+        p->processed( true);
+        o_ordered_vector.push_back( p);
+
+        if( core_dist_p == OPTICS::UNDEFINED)
+            return;
+
+        SeedHeap& seeds = ws.seeds;
+        seeds.clear();
+        update_seeds( N_eps, core_dist_p, seeds);
+
+        while( DataPoint* q = seeds.pop()) {
+            N_eps.clear();
+            index.range_query( q, eps, N_eps);
+            const real core_dist_q = squared_core_distance( N_eps, min_pts, ws.core_heap);
+            q->core_distance( core_dist_q);
+            q->processed( true);
+            o_ordered_vector.push_back( q);
+            if( core_dist_q != OPTICS::UNDEFINED) {
+                // *** q is a core-object ***
+                update_seeds( N_eps, core_dist_q, seeds);
+            }
+        }
+    }
+
     
     // HELPERS ####################################################################################
 
@@ -253,6 +556,35 @@ namespace OPTICS {
     }
 
 
+    /** Updates the seeds priority queue with new neighbors or neighbors that now have a better 
+     * reachability distance than before.
+     * Uses the distances that were stored in the neighborhood during the neighbor scan.
+     * @param N_eps All points in the the epsilon-neighborhood of the center object, including 
+     *        the center object itself, together with their squared distances to the center object.
+     * @param c_dist The core distance of the center object.
+     * @param o_seeds The seeds priority queue that will be modified.
+     */
+    void update_seeds( const Neighborhood& N_eps, const real c_dist, SeedHeap& o_seeds) {
+        assert( c_dist != OPTICS::UNDEFINED && "the core distance must be set <> UNDEFINED when entering update_seeds");
+        
+        for( Neighborhood::const_iterator it=N_eps.begin(); it!=N_eps.end(); ++it) {
+            DataPoint* o = it->point;
+
+            if( o->is_processed())
+                continue;
+
+            const real new_r_dist = std::max( c_dist, it->distance);
+            // *** new_r_dist != UNDEFINED ***
+        
+            if( new_r_dist < o->reachability_distance()) {
+                // *** o not in seeds, or already in seeds & can be improved ***
+                o->reachability_distance( new_r_dist);
+                o_seeds.push( o);
+            }
+        }
+    }
+
+
     /** Retrieves all points in the epsilon-surrounding of the given data point, including the point itself.
      * @param p The datapoint which represents the center of the epsilon surrounding.
      * @param eps The epsilon value that represents the radius for the neigborhood search.
@@ -262,7 +594,7 @@ namespace OPTICS {
      */
     DataVector get_neighbors( const DataPoint* p, const real eps, DataVector& db) {
         assert( eps >= 0 && "eps must not be negative");
-        DataVector ret;
+        DataVector ret( db.get_allocator());
 
         const real eps_sq = eps*eps;
 
@@ -276,6 +608,55 @@ namespace OPTICS {
     }
 
 
+    /** Retrieves all points in the epsilon-surrounding of the given data point, including the point itself,
+     * and finds the squared core distance of the point during the same scan.
+     * The min_pts+1 smallest distances are tracked with a bounded max-heap, so neither a second pass
+     * over the neighborhood nor a selection is needed. The heap is only filled once the neighborhood
+     * has more than min_pts elements, so points that are no core points never touch it.
+     * @param p The datapoint which represents the center of the epsilon surrounding.
+     * @param eps The epsilon value that represents the radius for the neigborhood search.
+     * @param min_pts The minimum number of points to be found within an epsilon-neigborhood.
+     * @param db The database consisting of all datapoints that are checked for neighborhood.
+     * @param o_N_eps Receives all datapoints that lie within the epsilon-neighborhood of the 
+     *        given point p, including p itself, together with their squared distances to p.
+     *        The previous content is cleared.
+     * @param heap A buffer for the bounded heap. The previous content is cleared.
+     * @return The squared core distance of p. Is OPTICS::UNDEFINED if p is no core point.
+     * @see squared_core_distance()
+     */
+    real get_neighbors( const DataPoint* p, const real eps, const unsigned int min_pts, DataVector& db, Neighborhood& o_N_eps, RealVector& heap) {
+        assert( eps >= 0 && "eps must not be negative");
+        assert( min_pts > 0 && "min_pts must be greater than 0");
+        o_N_eps.clear();
+        heap.clear(); // the min_pts+1 smallest distances, largest on top
+
+        const real eps_sq = eps*eps;
+
+        for( auto q_it=db.begin(); q_it!=db.end(); ++q_it) {
+            DataPoint* q = *q_it;
+            const real d = squared_distance( p, q);
+            if( d > eps_sq)
+                continue;
+
+            Neighbor n = { q, d };
+            o_N_eps.push_back( n);
+
+            if( o_N_eps.size() <= min_pts) {
+                continue;
+            } else if( heap.empty()) {
+                // *** p is a core point from now on; the heap starts with the first min_pts+1 neighbors ***
+                for( auto it=o_N_eps.begin(); it!=o_N_eps.end(); ++it)
+                    heap.push_back( it->distance);
+                std::make_heap( heap.begin(), heap.end());
+            } else if( d < heap.front()) {
+                std::pop_heap( heap.begin(), heap.end());
+                heap.back() = d;
+                std::push_heap( heap.begin(), heap.end());
+            }
+        }
+        return heap.empty() ? OPTICS::UNDEFINED : heap.front();
+    }
+
     /** Finds the squared core distance of one given point.
      * @param p The point to be examined.
      * @param min_pts The minimum number of points to be found within an epsilon-neigborhood.
@@ -298,19 +679,39 @@ namespace OPTICS {
     }
 
 
+    /** Determines the squared core distance of a point from its epsilon-neighborhood.
+     * @param N_eps The epsilon-neighborhood of the point, including the point itself.
+     * @param min_pts The minimum number of points to be found within an epsilon-neigborhood.
+     * @param buffer A scratch buffer for the distances. Its content is overwritten.
+     * @return The squared distance to the (min_pts+1)-th closest point of N_eps, 
+     *         or OPTICS::UNDEFINED if N_eps has not more than min_pts points.
+     */
+    real squared_core_distance( const Neighborhood& N_eps, const unsigned int min_pts, RealVector& buffer) {
+        if( N_eps.size() <= min_pts)
+            return OPTICS::UNDEFINED;
+
+        buffer.clear();
+        for( auto it=N_eps.begin(); it!=N_eps.end(); ++it)
+            buffer.push_back( it->distance);
+        std::nth_element( buffer.begin(), buffer.begin() + min_pts, buffer.end());
+        return buffer[min_pts];
+    }
+
+
     /** Retrieves the squared euclidean distance of two DataPoints.
      * @param a The first DataPoint.
      * @param b The second DataPoint. Both data points must have the same dimensionality.
      */
     real squared_distance( const DataPoint* a, const DataPoint* b) {
-        const std::vector<real>& a_data = a->data();
-        const std::vector<real>& b_data = b->data();
+        const RealVector& a_data = a->data();
+        const RealVector& b_data = b->data();
         const unsigned int vec_size = static_cast<unsigned int>(a_data.size());
         assert( vec_size == b_data.size() && "Data-vectors of both DataPoints must have same dimensionality");
         real ret(0);
     
         for( unsigned int i=0; i<vec_size; ++i) {
-            ret += std::pow( a_data[i]-b_data[i], 2);
+            const real diff = a_data[i]-b_data[i];
+            ret += diff*diff;
         }
         //return std::sqrt( ret);
         return ret;
@@ -378,4 +779,159 @@ namespace OPTICS {
         return ret;
     }
 
-} // END namespace OPTICS
+
+
+    /** Labels the specified OPTICS ordered data points along the given cluster borders without copying them.
+     * This is the allocation-free counterpart of extract_clusters(). The ordering is split into chunks 
+     * which are labelled in parallel. The first label of each chunk is the number of cluster borders 
+     * before the chunk, i.e. the prefix sum over the border list, which is found with a binary search.
+     * @param result The OPTICS ordered result vector of the optics function.
+     * @param cluster_borders A vector of indices specifiying the cluster borders.
+     *        IMPORTANT: The vector must be sorted in ascending order.
+     * @param outlier_threshold All values above that outlier_threshold are considered outliers
+     *        and will be labelled OPTICS::NOISE. Is the threshold value set 
+     *        to 0 or negative no point will be considered as an outlier.
+     * @param o_labels A caller-provided buffer of at least result.size() elements. The i-th element
+     *        receives the label of the i-th point of the result vector. The label of the points
+     *        between the (i-1)-th and the i-th cluster border is i. Outliers are labelled OPTICS::NOISE.
+     * @param pool The thread pool that labels the chunks.
+     * @see optics()
+     * @see extract_clusters()
+     */
+    void extract_cluster_labels( const DataVector& result, 
+                                 const std::vector<unsigned int>& cluster_borders, 
+                                 real outlier_threshold, 
+                                 std::int32_t* o_labels, 
+                                 ThreadPool& pool) {
+        assert( std::is_sorted( cluster_borders.begin(), cluster_borders.end()) && "cluster borders must be sorted in ascending order");
+        const std::size_t min_chunk_size = 1 << 16;
+        const std::size_t n = result.size();
+
+        if( outlier_threshold <= 0)
+            outlier_threshold = std::numeric_limits<real>::max();
+
+        auto label_chunk = [&]( const std::size_t lower_idx, const std::size_t upper_idx) {
+            auto border_it = std::upper_bound( cluster_borders.begin(), cluster_borders.end(), lower_idx);
+            std::int32_t label = static_cast<std::int32_t>(border_it - cluster_borders.begin());
+
+            for( std::size_t j=lower_idx; j<upper_idx; ++j) {
+                while( border_it != cluster_borders.end() && *border_it <= j) {
+                    ++border_it;
+                    ++label;
+                }
+                o_labels[j] = result[j]->reachability_distance() > outlier_threshold ? NOISE : label;
+            }
+        };
+
+        pool.parallel_for( 0, n, min_chunk_size, label_chunk);
+    }
+
+
+    /** Partitions the specified OPTICS ordered data points along the given cluster borders without copying them.
+     * The clusters are returned as index ranges into the result vector. Unlike extract_clusters(), 
+     * outliers are not separated from the clusters; use extract_cluster_labels() for that.
+     * @param result The OPTICS ordered result vector of the optics function.
+     * @param cluster_borders A vector of indices specifiying the cluster borders.
+     *        IMPORTANT: The vector must be sorted in ascending order.
+     * @return One span per cluster. The i-th span covers the points between the (i-1)-th and the i-th cluster border.
+     * @see optics()
+     * @see extract_clusters()
+     */
+    std::vector<ClusterSpan> cluster_spans( const DataVector& result, const std::vector<unsigned int>& cluster_borders) {
+        std::vector<ClusterSpan> ret;
+        ret.reserve( cluster_borders.size() + 1);
+
+        for( unsigned int i=0; i<=cluster_borders.size(); ++i) {
+            ClusterSpan span;
+            span.begin = i == 0                        ? 0                                        : cluster_borders[i-1];
+            span.end   = i == cluster_borders.size()   ? static_cast<unsigned int>(result.size()) : cluster_borders[i];
+            ret.push_back( span);
+        }
+        return ret;
+    }
+
+    /** Extracts a flat DBSCAN-equivalent clustering for a given eps' from the OPTICS ordering
+     * in a single linear pass over the reachability and core distances ("ExtractDBSCAN-Clustering"
+     * as described in the OPTICS paper). The result is the same as running DBSCAN with eps'
+     * and min_pts, except for border points that are density-reachable from more than one cluster.
+     * @param result The OPTICS ordered result vector of the optics function.
+     * @param eps_prime The epsilon of the extracted DBSCAN clustering. Must not be greater
+     *        than the eps that was used by the optics function.
+     * @return One cluster label per point, ordered like the result vector. Cluster labels are
+     *         enumerated from 0 on in the order of appearance. Noise points get the label OPTICS::NOISE.
+     * @see optics()
+     */
+    std::vector<int> extract_dbscan( const DataVector& result, const real eps_prime) {
+        assert( eps_prime >= 0 && "eps' must not be negative");
+        std::vector<int> ret;
+        ret.reserve( result.size());
+
+        const real eps_prime_sq = eps_prime*eps_prime;
+        int cluster_id = NOISE;
+
+        for( auto p_it=result.begin(); p_it!=result.end(); ++p_it) {
+            const DataPoint* p = *p_it;
+
+            // *** eps_prime_sq overflows to infinity for eps' = OPTICS::UNDEFINED, so UNDEFINED is tested explicitly ***
+            if( p->reachability_distance() == OPTICS::UNDEFINED || p->reachability_distance() > eps_prime_sq) {
+                if( p->core_distance() != OPTICS::UNDEFINED && p->core_distance() <= eps_prime_sq) {
+                    ret.push_back( ++cluster_id);
+                } else {
+                    ret.push_back( NOISE);
+                }
+            } else {
+                ret.push_back( cluster_id);
+            }
+        }
+        return ret;
+    }
+
+
+    /** Extracts flat DBSCAN-equivalent clusterings for many values of eps' at once.
+     * The OPTICS ordering is traversed only once, and every point updates the clusterings
+     * of all eps' values. The labels are computed point-major into one flat buffer with
+     * branch-free updates, so that the loop over the eps' values can be vectorized,
+     * and are transposed into one label vector per eps' value afterwards.
+     * @param result The OPTICS ordered result vector of the optics function.
+     * @param eps_primes The epsilons of the extracted DBSCAN clusterings. None of them must be
+     *        greater than the eps that was used by the optics function.
+     * @return One label vector per eps' value, in the order of the given eps' values.
+     *         Each label vector is as described in extract_dbscan( const DataVector&, const real).
+     * @see optics()
+     */
+    std::vector<std::vector<int>> extract_dbscan( const DataVector& result, const std::vector<real>& eps_primes) {
+        const std::size_t n_eps = eps_primes.size();
+        const std::size_t n_points = result.size();
+
+        std::vector<real> eps_primes_sq( n_eps);
+        for( std::size_t j=0; j<n_eps; ++j) {
+            assert( eps_primes[j] >= 0 && "eps' must not be negative");
+            eps_primes_sq[j] = eps_primes[j]*eps_primes[j];
+        }
+        std::vector<int> n_clusters( n_eps); // per eps', the number of clusters found so far
+        std::vector<int> labels( n_points * n_eps);
+
+        for( std::size_t i=0; i<n_points; ++i) {
+            const real r_dist = result[i]->reachability_distance();
+            const real c_dist = result[i]->core_distance();
+            // *** eps_prime_sq overflows to infinity for eps' = OPTICS::UNDEFINED, so UNDEFINED is tested here, once per point ***
+            const int r_defined = r_dist != OPTICS::UNDEFINED;
+            const int c_defined = c_dist != OPTICS::UNDEFINED;
+            const std::size_t row = i*n_eps;
+
+            for( std::size_t j=0; j<n_eps; ++j) {
+                const int is_reached = r_defined & (r_dist <= eps_primes_sq[j]);
+                const int is_core    = c_defined & (c_dist <= eps_primes_sq[j]);
+                n_clusters[j] += ~is_reached & is_core;
+                labels[row + j] = (is_reached | is_core) ? n_clusters[j]-1 : NOISE;
+            }
+        }
+
+        std::vector<std::vector<int>> ret( n_eps, std::vector<int>( n_points));
+        for( std::size_t j=0; j<n_eps; ++j)
+            for( std::size_t i=0; i<n_points; ++i)
+                ret[j][i] = labels[i*n_eps + j];
+        return ret;
+    }
+
+} // END namespace OPTICS
\ No newline at end of file
@@ -0,0 +1,187 @@
+/******************************************************************************
+/* @file Contains a persistence-based peak detection on OPTICS reachability
+/*       plots, which can be used to find cluster borders.
+/*
+/*
+/* @author langenhagen
+/* @version 261016
+/******************************************************************************/
+#pragma once
+
+///////////////////////////////////////////////////////////////////////////////
+// INCLUDES project headers
+
+#include "DataPoint.hpp"
+
+///////////////////////////////////////////////////////////////////////////////
+//INCLUDES C/C++ standard library (and other external libraries)
+
+#include <algorithm> // sort, upper_bound
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+// NAMESPACE, CONSTANTS and TYPE DECLARATIONS/IMPLEMENTATIONS
+
+namespace OPTICS {
+
+    /// A local maximum of a 1D function paired with the local minimum that dies when it is reached.
+    struct PersistencePair {
+        unsigned int max_index; ///< Index of the local maximum, i.e. the peak.
+        unsigned int min_index; ///< Index of the local minimum that is paired with the maximum.
+        real persistence;       ///< Difference between the values at max_index and min_index.
+    };
+
+
+    /** Implements 0-dimensional persistence on a 1D function, e.g. on an OPTICS reachability plot.
+     * The persistence pairs are computed once in O(n log n) with a union-find sweep over the values
+     * and are cached in descending order of persistence. Queries for the k most persistent peaks
+     * are then answered in O(k), queries for all peaks above a persistence threshold in O(log n + k).
+     * The first and the last index are never reported as a peak.
+     */
+    class Persistence {
+
+    private: // vars
+
+        std::vector<PersistencePair> _pairs; ///< The persistence pairs, sorted in descending order of persistence.
+
+    public: // ctor & dtor
+
+        /// Default constructor. Creates an object without any persistence pairs.
+        Persistence()
+        {}
+
+        /** Main constructor.
+         * Computes the persistence pairs of the given values.
+         * @param values The function values, e.g. the reachability distances of an OPTICS ordering.
+         */
+        explicit Persistence( const std::vector<real>& values) {
+            run( values);
+        }
+
+        /** Convenience constructor.
+         * Computes the persistence pairs of the reachability distances of an OPTICS ordering.
+         * @param result The OPTICS ordered result vector of the optics function.
+         * @see optics()
+         */
+        explicit Persistence( const DataVector& result) {
+            std::vector<real> values;
+            values.reserve( result.size());
+            for( auto it=result.begin(); it!=result.end(); ++it)
+                values.push_back( (*it)->reachability_distance());
+            run( values);
+        }
+
+    public: // methods
+
+        /** (Re)computes the persistence pairs of the given values in O(n log n).
+         * The values are swept in ascending order. Each local minimum gives birth to a component,
+         * each local maximum merges two components. At a merge, the component with the higher
+         * minimum dies and its minimum gets paired with the maximum.
+         * @param values The function values, e.g. the reachability distances of an OPTICS ordering.
+         */
+        void run( const std::vector<real>& values) {
+            const unsigned int n = static_cast<unsigned int>(values.size());
+            _pairs.clear();
+
+            std::vector<unsigned int> order( n);
+            for( unsigned int i=0; i<n; ++i)
+                order[i] = i;
+            std::sort( order.begin(), order.end(), [&values]( unsigned int a, unsigned int b) {
+                return values[a] < values[b] || (values[a] == values[b] && a < b);
+            });
+
+            const unsigned int unseen = n;
+            std::vector<unsigned int> parent( n, unseen); // union-find forest, unseen for indices not yet swept
+            std::vector<unsigned int> birth( n);          // index of the minimum of a component, valid at its root
+
+            for( auto it=order.begin(); it!=order.end(); ++it) {
+                const unsigned int i = *it;
+                const bool has_left  = i > 0   && parent[i-1] != unseen;
+                const bool has_right = i+1 < n && parent[i+1] != unseen;
+
+                if( !has_left && !has_right) {
+                    // *** local minimum ***
+                    parent[i] = i;
+                    birth[i] = i;
+
+                } else if( has_left != has_right) {
+                    parent[i] = find( parent, has_left ? i-1 : i+1);
+
+                } else {
+                    // *** local maximum ***
+                    unsigned int older   = find( parent, i-1);
+                    unsigned int younger = find( parent, i+1);
+                    if( values[birth[younger]] < values[birth[older]] ||
+                       (values[birth[younger]] == values[birth[older]] && birth[younger] < birth[older]))
+                        std::swap( older, younger);
+
+                    PersistencePair pair;
+                    pair.max_index = i;
+                    pair.min_index = birth[younger];
+                    pair.persistence = values[i] - values[birth[younger]];
+                    _pairs.push_back( pair);
+
+                    parent[younger] = older;
+                    parent[i] = older;
+                }
+            }
+
+            std::stable_sort( _pairs.begin(), _pairs.end(), []( const PersistencePair& a, const PersistencePair& b) {
+                return a.persistence > b.persistence;
+            });
+        }
+
+        /** Retrieves all persistence pairs.
+         * @return The persistence pairs, sorted in descending order of persistence.
+         */
+        inline const std::vector<PersistencePair>& pairs() const { return _pairs; }
+
+        /** Retrieves the indices of the k most persistent peaks in O(k).
+         * @param k The number of peaks to retrieve. If less than k peaks exist, all peak indices are returned.
+         * @return The peak indices, ordered in descending order of the persistence of the peaks.
+         */
+        std::vector<unsigned int> most_persistent_peaks( const unsigned int k) const {
+            const std::size_t n = std::min<std::size_t>( k, _pairs.size());
+            std::vector<unsigned int> ret;
+            ret.reserve( n);
+            for( std::size_t i=0; i<n; ++i)
+                ret.push_back( _pairs[i].max_index);
+            return ret;
+        }
+
+        /** Counts the peaks with a persistence greater than a given threshold in O(log n).
+         * @param threshold The persistence threshold.
+         * @return The number of peaks with a persistence greater than the threshold.
+         */
+        std::size_t count_above( const real threshold) const {
+            auto it = std::upper_bound( _pairs.begin(), _pairs.end(), threshold, []( real t, const PersistencePair& p) {
+                return t >= p.persistence;
+            });
+            return static_cast<std::size_t>(it - _pairs.begin());
+        }
+
+        /** Retrieves the indices of all peaks with a persistence greater than a given threshold in O(log n + k).
+         * @param threshold The persistence threshold.
+         * @return The peak indices, ordered in descending order of the persistence of the peaks.
+         */
+        std::vector<unsigned int> peaks_above( const real threshold) const {
+            return most_persistent_peaks( static_cast<unsigned int>(count_above( threshold)));
+        }
+
+    private: // helpers
+
+        /** Finds the root of the component of the given index, while halving the path to it.
+         * @param parent The union-find forest.
+         * @param i The index whose root is to be found. Must be already swept.
+         * @return The root index of the component.
+         */
+        static unsigned int find( std::vector<unsigned int>& parent, unsigned int i) {
+            while( parent[i] != i) {
+                parent[i] = parent[parent[i]];
+                i = parent[i];
+            }
+            return i;
+        }
+    };
+
+} // END namespace OPTICS
@@ -0,0 +1,396 @@
+/******************************************************************************
+/* @file Contains a pipelined variant of the OPTICS algorithm, in which worker
+/*       threads compute the epsilon-neighborhoods of the most promising seeds
+/*       ahead of time.
+/*
+/*
+/* @author langenhagen
+/* @version 261016
+/******************************************************************************/
+#pragma once
+
+///////////////////////////////////////////////////////////////////////////////
+// INCLUDES project headers
+
+#include "optics.hpp"
+#include "thread_pool.hpp"
+
+///////////////////////////////////////////////////////////////////////////////
+//INCLUDES C/C++ standard library (and other external libraries)
+
+#include <algorithm> // find
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+// NAMESPACE, CONSTANTS and TYPE DECLARATIONS/IMPLEMENTATIONS
+
+namespace OPTICS {
+
+    /** Implements the speculative computation of epsilon-neighborhoods and core distances
+     * of given points on a ThreadPool, i.e. before the OPTICS expansion asks for them.
+     * The prefetcher holds a fixed number of slots, one per point whose neighborhood is requested.
+     * The main thread requests the neighborhoods of the next seeds with prefetch() and fetches
+     * them with take() when the points are actually expanded. Since neighborhoods depend on the
+     * coordinates only, a prefetched neighborhood is always valid, no matter how the seed list
+     * has changed in between. The workers only read the coordinates of the points, the main thread
+     * only writes their reachability distances, core distances and processed flags.
+     */
+    class NeighborhoodPrefetcher {
+
+    private: // types
+
+        /// The states of a slot.
+        enum SlotState {
+            FREE,       ///< The slot can be assigned a point.
+            PENDING,    ///< The point waits for a worker.
+            RUNNING,    ///< A worker computes the neighborhood of the point.
+            READY,      ///< The neighborhood of the point is available.
+            TAKEN       ///< The main thread reads the neighborhood of the point.
+        };
+
+        /// A slot for the neighborhood of one point.
+        struct Slot {
+            const DataPoint* point;     ///< The point whose neighborhood is computed.
+            SlotState state;            ///< The state of the slot.
+            real core_distance;         ///< The squared core distance of the point, once the slot is READY.
+            Neighborhood neighbors;     ///< The epsilon-neighborhood of the point, once the slot is READY.
+            RealVector core_heap;       ///< The buffer for the bounded heap that finds the core distance.
+        };
+
+    private: // vars
+
+        DataVector& _db;                    ///< All data points.
+        const real _eps;                    ///< The epsilon of the neighborhoods.
+        const unsigned int _min_pts;        ///< The minimum number of points of a core point's neighborhood.
+        std::vector<Slot> _slots;           ///< The slots. Their number is fixed.
+        std::deque<std::size_t> _queue;     ///< The indices of the PENDING slots, in the order they should be computed.
+        ThreadPool& _pool;                  ///< The pool that runs the tasks.
+        std::size_t _n_waiting_tasks;       ///< The number of submitted tasks that have not started yet.
+        std::size_t _n_tasks;               ///< The number of submitted tasks that have not finished yet.
+        std::mutex _mutex;                  ///< Guards the slot states, the slot points, the queue and the task counters.
+        std::condition_variable _work_done; ///< Signals the main thread that a slot became READY.
+        DataVector _requested;              ///< The points of the last call to prefetch(). Main thread only.
+        bool _is_request_complete;          ///< Whether all points of the last call to prefetch() got a slot. Main thread only.
+
+    public: // ctor & dtor
+
+        /** Main constructor.
+         * @param db All data points. Must not change while the prefetcher exists.
+         * @param eps The epsilon representing the radius of the epsilon-neighborhood.
+         * @param min_pts The minimum number of points to be found within an epsilon-neigborhood.
+         * @param n_slots The maximum number of neighborhoods that are held at the same time. Must be greater than 0.
+         * @param pool The thread pool that computes the neighborhoods. Must have at least one worker.
+         */
+        NeighborhoodPrefetcher( DataVector& db, const real eps, const unsigned int min_pts, const unsigned int n_slots, ThreadPool& pool)
+            : _db( db), _eps( eps), _min_pts( min_pts), _slots( n_slots), _pool( pool), _n_waiting_tasks( 0), _n_tasks( 0), _is_request_complete( false) {
+            assert( n_slots > 0 && "n_slots must be greater than 0");
+            assert( pool.size() > 0 && "The pool must have at least one worker");
+            for( auto it=_slots.begin(); it!=_slots.end(); ++it) {
+                it->point = nullptr;
+                it->state = FREE;
+                it->core_heap.reserve( min_pts+1);
+            }
+            _requested.reserve( n_slots);
+        }
+
+        /// Destructor. Drops the queued work and waits for the submitted tasks.
+        ~NeighborhoodPrefetcher() {
+            std::unique_lock<std::mutex> lock( _mutex);
+            _queue.clear();
+            while( _n_tasks > 0) {
+                lock.unlock();
+                if( !_pool.run_pending_task())
+                    std::this_thread::yield();
+                lock.lock();
+            }
+        }
+
+    private: // forbidden copy construction and assignment; the tasks refer to this object
+
+        NeighborhoodPrefetcher( const NeighborhoodPrefetcher&);
+        NeighborhoodPrefetcher& operator=( const NeighborhoodPrefetcher&);
+
+    public: // methods
+
+        /** Requests the neighborhoods of the given points, most urgent first.
+         * Slots of points that are not requested anymore are recycled, unless a worker is busy with them.
+         * Points that do not fit into the free slots are not prefetched.
+         * If the points equal those of the last call and all of them got a slot, nothing is to be done
+         * and the call returns without locking.
+         * @param points The points whose neighborhoods will probably be needed next, most urgent first.
+         */
+        void prefetch( const DataVector& points) {
+            if( _is_request_complete && points == _requested)
+                return; // *** the slots still hold exactly these points ***
+            _requested.assign( points.begin(), points.end());
+            _is_request_complete = true;
+
+            std::unique_lock<std::mutex> lock( _mutex);
+
+            // recycle slots that are not wanted anymore
+            for( auto it=_slots.begin(); it!=_slots.end(); ++it) {
+                if( (it->state == PENDING || it->state == READY) && std::find( points.begin(), points.end(), it->point) == points.end()) {
+                    it->state = FREE;
+                    it->point = nullptr;
+                }
+            }
+            _queue.clear();
+
+            // queue the wanted points in order of urgency
+            for( auto p_it=points.begin(); p_it!=points.end(); ++p_it) {
+                Slot* slot = find_slot( *p_it);
+                if( slot == nullptr) {
+                    slot = find_slot( nullptr);
+                    if( slot == nullptr) {
+                        _is_request_complete = false;
+                        break; // *** all slots in use ***
+                    }
+                    slot->point = *p_it;
+                    slot->state = PENDING;
+                }
+                if( slot->state == PENDING)
+                    _queue.push_back( slot - &_slots.front());
+            }
+
+            // every task computes the most urgent PENDING slot when it starts, so only missing tasks are submitted
+            const std::size_t n_new_tasks = _queue.size() > _n_waiting_tasks ? _queue.size() - _n_waiting_tasks : 0;
+            _n_waiting_tasks += n_new_tasks;
+            _n_tasks += n_new_tasks;
+            lock.unlock();
+
+            for( std::size_t i=0; i<n_new_tasks; ++i)
+                _pool.submit( [this]() { run_task(); });
+        }
+
+        /** Fetches the neighborhood of a point, waiting for a worker if it is being computed.
+         * If a neighborhood is returned, it stays valid until release() is called.
+         * @param p The point.
+         * @param o_core_distance Receives the squared core distance of p, if a neighborhood is returned.
+         * @return The epsilon-neighborhood of p, or nullptr if it has not been prefetched.
+         *         In the latter case, the caller has to compute the neighborhood itself.
+         */
+        const Neighborhood* take( const DataPoint* p, real& o_core_distance) {
+            std::unique_lock<std::mutex> lock( _mutex);
+            Slot* slot = find_slot( p);
+            if( slot == nullptr)
+                return nullptr;
+
+            if( slot->state == PENDING) {
+                // *** no worker has started yet; the caller is faster computing it directly ***
+                _queue.erase( std::find( _queue.begin(), _queue.end(), static_cast<std::size_t>(slot - &_slots.front())));
+                slot->state = FREE;
+                slot->point = nullptr;
+                return nullptr;
+            }
+
+            _work_done.wait( lock, [slot]() { return slot->state == READY; });
+            slot->state = TAKEN;
+            o_core_distance = slot->core_distance;
+            return &slot->neighbors;
+        }
+
+        /** Frees the slot of a neighborhood that was returned by take().
+         * @param N_eps The neighborhood returned by take().
+         */
+        void release( const Neighborhood* N_eps) {
+            std::lock_guard<std::mutex> lock( _mutex);
+            for( auto it=_slots.begin(); it!=_slots.end(); ++it) {
+                if( &it->neighbors == N_eps) {
+                    assert( it->state == TAKEN && "The neighborhood must have been returned by take()");
+                    it->state = FREE;
+                    it->point = nullptr;
+                    return;
+                }
+            }
+            assert( false && "The neighborhood must have been returned by take()");
+        }
+
+    private: // helpers
+
+        /** Finds the slot that is assigned to a given point.
+         * Must be called while holding the mutex.
+         * @param p The point, or nullptr to find a FREE slot.
+         * @return The slot, or nullptr if there is none.
+         */
+        Slot* find_slot( const DataPoint* p) {
+            for( auto it=_slots.begin(); it!=_slots.end(); ++it) {
+                if( it->point == p && (p != nullptr || it->state == FREE))
+                    return &*it;
+            }
+            return nullptr;
+        }
+
+        /// A task on the pool. Computes the neighborhood of the most urgent PENDING slot, if any.
+        void run_task() {
+            std::unique_lock<std::mutex> lock( _mutex);
+            --_n_waiting_tasks;
+            if( !_queue.empty()) {
+                Slot& slot = _slots[_queue.front()];
+                _queue.pop_front();
+                slot.state = RUNNING;
+                lock.unlock();
+
+                const real core_dist = get_neighbors( slot.point, _eps, _min_pts, _db, slot.neighbors, slot.core_heap);
+
+                lock.lock();
+                slot.core_distance = core_dist;
+                slot.state = READY;
+                _work_done.notify_all();
+            }
+            --_n_tasks;
+        }
+    };
+
+
+
+    // FUNCTION DECLARATIONS ######################################################################
+
+    DataVector optics_pipelined( DataVector& db,
+                                 const real eps,
+                                 const unsigned int min_pts,
+                                 const unsigned int lookahead = 8,
+                                 std::function<void(const DataPoint* p)> point_processed_callback = nullptr,
+                                 ThreadPool& pool = default_pool());
+    void expand_cluster_order_pipelined( DataVector& db,
+                                         DataPoint* p,
+                                         const real eps,
+                                         const unsigned int min_pts,
+                                         DataVector& o_ordered_vector,
+                                         Workspace& ws,
+                                         NeighborhoodPrefetcher& prefetcher,
+                                         const unsigned int lookahead,
+                                         std::function<void(const DataPoint* p)> point_processed_callback);
+
+
+
+    // PIPELINED VERSION ##########################################################################
+
+
+    /** Performs the OPTICS algorithm while the workers of a thread pool compute the epsilon-neighborhoods
+     * of the next few seeds in the background.
+     * The next point to be expanded is almost always one of the seeds with the smallest reachability
+     * distances. Whenever the seed list changes, the neighborhoods of its top seeds are requested
+     * from a NeighborhoodPrefetcher, so that most neighborhood queries have finished by the time
+     * their point is popped. The points are still expanded one by one in strict OPTICS order,
+     * hence the result equals the result of optics().
+     * @param db All data points that are to be considered by the algorithm. Changes their values.
+     * @param eps The epsilon representing the radius of the epsilon-neighborhood.
+     *        If set to OPTICS::UNDEFINED, the work is delegated to optics_unbounded().
+     * @param min_pts The minimum number of points to be found within an epsilon-neigborhood.
+     * @param lookahead The number of top seeds whose neighborhoods are computed ahead of time.
+     *        If 0, nothing is prefetched and the algorithm runs sequentially.
+     * @param point_processed_callback Callback function that is called when one point is
+     *        added to the ordered output list. It takes the pointer to the data point as an argument.
+     *        Can be nullptr.
+     * @param pool The thread pool that computes the neighborhoods.
+     *        If it has no workers, the algorithm runs sequentially.
+     * @return Return the OPTICS ordered list of Data points with reachability-distances and core-distances set.
+     */
+    DataVector optics_pipelined( DataVector& db,
+                                 const real eps,
+                                 const unsigned int min_pts,
+                                 const unsigned int lookahead,
+                                 std::function<void(const DataPoint* p)> point_processed_callback,
+                                 ThreadPool& pool) {
+        assert( eps >= 0 && "eps must not be negative");
+        assert( min_pts > 0 && "min_pts must be greater than 0");
+        if( eps == OPTICS::UNDEFINED)
+            return optics_unbounded( db, min_pts, point_processed_callback, pool);
+        if( lookahead == 0 || pool.size() == 0)
+            return point_processed_callback ? optics( db, eps, min_pts, point_processed_callback) : optics( db, eps, min_pts);
+
+        DataVector ret( db.get_allocator());
+        ret.reserve( db.size());
+        Workspace ws;
+        NeighborhoodPrefetcher prefetcher( db, eps, min_pts, lookahead, pool);
+
+        for( auto p_it = db.begin(); p_it != db.end(); ++p_it) {
+            DataPoint* p = *p_it;
+
+            if( p->is_processed())
+                continue;
+
+            expand_cluster_order_pipelined( db, p, eps, min_pts, ret, ws, prefetcher, lookahead, point_processed_callback);
+        }
+        return ret;
+    }
+
+
+    /** Expands the cluster order while adding new neighbor points to the order,
+     * taking the neighborhoods of the popped seeds from a NeighborhoodPrefetcher where possible.
+     * @param db All data points that are to be considered by the algorithm. Changes their values.
+     * @param p The point to be examined.
+     * @param eps The epsilon representing the radius of the epsilon-neighborhood.
+     * @param min_pts The minimum number of points to be found within an epsilon-neigborhood.
+     * @param o_ordered_vector The ordered vector of data points. Elements will be added to this vector.
+     * @param ws The scratch memory of the run.
+     * @param prefetcher The prefetcher, created with the same db, eps and min_pts.
+     * @param lookahead The number of top seeds whose neighborhoods are requested ahead of time.
+     * @param point_processed_callback Callback function that is called when one point is
+     *        added to the ordered output list. It takes the pointer to the data point as an argument.
+     *        Can be nullptr.
+     */
+    void expand_cluster_order_pipelined( DataVector& db,
+                                         DataPoint* p,
+                                         const real eps,
+                                         const unsigned int min_pts,
+                                         DataVector& o_ordered_vector,
+                                         Workspace& ws,
+                                         NeighborhoodPrefetcher& prefetcher,
+                                         const unsigned int lookahead,
+                                         std::function<void(const DataPoint* p)> point_processed_callback) {
+        assert( eps >= 0 && "eps must not be negative");
+        assert( min_pts > 0 && "min_pts must be greater than 0");
+
+        p->reachability_distance( OPTICS::UNDEFINED);
+        const real core_dist_p = get_neighbors( p, eps, min_pts, db, ws.neighbors, ws.core_heap);
+        p->core_distance( core_dist_p);
+        p->processed( true);
+        o_ordered_vector.push_back( p);
+        if( point_processed_callback)
+            point_processed_callback( p);
+
+        if( core_dist_p == OPTICS::UNDEFINED)
+            return;
+
+        SeedHeap& seeds = ws.seeds;
+        seeds.clear();
+        update_seeds( ws.neighbors, core_dist_p, seeds);
+
+        DataVector top_seeds;
+        top_seeds.reserve( lookahead);
+        seeds.top( lookahead, top_seeds);
+        prefetcher.prefetch( top_seeds);
+
+        while( DataPoint* q = seeds.pop()) {
+            real core_dist_q;
+            const Neighborhood* N_eps = prefetcher.take( q, core_dist_q);
+            const bool is_prefetched = N_eps != nullptr;
+            if( !is_prefetched) {
+                core_dist_q = get_neighbors( q, eps, min_pts, db, ws.neighbors, ws.core_heap);
+                N_eps = &ws.neighbors;
+            }
+
+            q->core_distance( core_dist_q);
+            q->processed( true);
+            o_ordered_vector.push_back( q);
+            if( point_processed_callback)
+                point_processed_callback( q);
+            if( core_dist_q != OPTICS::UNDEFINED) {
+                // *** q is a core-object ***
+                update_seeds( *N_eps, core_dist_q, seeds);
+            }
+
+            if( is_prefetched)
+                prefetcher.release( N_eps);
+            seeds.top( lookahead, top_seeds);
+            prefetcher.prefetch( top_seeds);
+        }
+    }
+
+} // END namespace OPTICS
@@ -0,0 +1,205 @@
+/******************************************************************************
+/* @file Contains the PointStore class that creates and owns DataPoints in bulk.
+/*
+/*
+/* @author langenhagen
+/* @version 261016
+/******************************************************************************/
+#pragma once
+
+///////////////////////////////////////////////////////////////////////////////
+// INCLUDES project headers
+
+#include "DataPoint.hpp"
+#include "spatial_sort.hpp"
+
+///////////////////////////////////////////////////////////////////////////////
+//INCLUDES C/C++ standard library (and other external libraries)
+
+#include <algorithm> // copy, max
+#include <memory>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+// NAMESPACE, CONSTANTS and TYPE DECLARATIONS/IMPLEMENTATIONS
+
+namespace OPTICS {
+
+    /** Implements a bulk factory and owner of DataPoints.
+     * All DataPoints are placed in one contiguous array instead of being created one by one with new.
+     * The data elements of all points are placed in one MonotonicArena as well, so that loading n points
+     * takes a constant number of allocations and tearing them down frees a constant number of blocks.
+     * The points are accessible as a DataVector, so that they can be passed to optics() as usual.
+     * They live as long as the store; do not delete them.
+     * The points can be physically reordered along a space-filling curve, so that points that are close
+     * in space are close in memory as well. The store keeps track of the original index of each point.
+     */
+    class PointStore {
+
+    private: // vars
+
+        std::unique_ptr<MonotonicArena> _arena; ///< The arena of the data elements.
+        std::vector<DataPoint> _points; ///< The points.
+        DataVector _view;               ///< Pointers to the points.
+        unsigned int _dim;              ///< The dimensionality of the points.
+        std::vector<std::size_t> _original_indices; ///< The index each point had when it was created. Empty if the points were never reordered.
+
+    public: // ctor & dtor
+
+        /// Default constructor. Creates an empty store.
+        PointStore() : _dim( 0)
+        {}
+
+        /** Main constructor.
+         * Creates n points of the given dimensionality, with all data elements set to 0.
+         * @param n The number of points.
+         * @param dim The dimensionality of the points.
+         */
+        PointStore( const std::size_t n, const unsigned int dim) : _dim( 0) {
+            reset( n, dim);
+        }
+
+        /** Convenience constructor.
+         * Creates points from a row-major array of coordinates.
+         * @param coords The coordinates, dim values per point.
+         * @param n The number of points.
+         * @param dim The dimensionality of the points.
+         */
+        PointStore( const real* coords, const std::size_t n, const unsigned int dim) : _dim( 0) {
+            reset( n, dim);
+            for( std::size_t i=0; i<n; ++i)
+                std::copy( coords + i*dim, coords + (i+1)*dim, _points[i].data().begin());
+        }
+
+    private: // forbidden copy construction and assignment; the view points into the store
+
+        PointStore( const PointStore&);
+        PointStore& operator=( const PointStore&);
+
+    public: // methods
+
+        /** Destroys all points and creates n new points of the given dimensionality, with all data elements set to 0.
+         * @param n The number of points.
+         * @param dim The dimensionality of the points.
+         */
+        void reset( const std::size_t n, const unsigned int dim) {
+            _view.clear();
+            _points.clear();
+            _points.shrink_to_fit();
+            _original_indices.clear();
+            _dim = dim;
+
+            _arena.reset( new MonotonicArena( std::max<std::size_t>( 1, n*dim*sizeof( real))));
+            const Allocator<real>::type alloc( _arena.get());
+            _points.reserve( n);
+            _view.reserve( n);
+            for( std::size_t i=0; i<n; ++i) {
+                _points.emplace_back( alloc);
+                _points.back().data().resize( dim);
+                _view.push_back( &_points.back());
+            }
+        }
+
+        /** Physically reorders the points along a space-filling curve.
+         * Afterwards, spatially close points lie next to each other in memory, which makes the
+         * neighbor scans and the seed expansion of optics() cache- and TLB-friendly.
+         * Pointers to the points become invalid; points() is rebuilt in the new storage order.
+         * The data elements are kept; reachability distances, core distances and processed flags are reset.
+         * @param curve The space-filling curve.
+         * @see original_index()
+         */
+        void sort_spatially( const SpaceFillingCurve curve = HILBERT) {
+            const std::size_t n = _points.size();
+            DataVector by_index( _points.size());
+            for( std::size_t i=0; i<n; ++i)
+                by_index[i] = &_points[i];
+            const std::vector<std::size_t> order = spatial_order( by_index, curve);
+
+            std::vector<std::size_t> original_indices( n);
+            for( std::size_t i=0; i<n; ++i)
+                original_indices[i] = _original_indices.empty() ? order[i] : _original_indices[order[i]];
+
+            std::unique_ptr<MonotonicArena> arena( new MonotonicArena( std::max<std::size_t>( 1, n*_dim*sizeof( real))));
+            const Allocator<real>::type alloc( arena.get());
+            std::vector<DataPoint> points;
+            points.reserve( n);
+            for( std::size_t i=0; i<n; ++i) {
+                points.emplace_back( alloc);
+                const RealVector& data = _points[order[i]].data();
+                points.back().data().assign( data.begin(), data.end());
+            }
+
+            _view.clear();
+            _points.swap( points);
+            points.clear();
+            _arena.swap( arena);
+            for( std::size_t i=0; i<n; ++i)
+                _view.push_back( &_points[i]);
+            _original_indices.swap( original_indices);
+        }
+
+        /** Retrieves the index a point had when it was created, i.e. before any reordering.
+         * Use this to map results of optics() back to the caller's original indices.
+         * @param p A point of this store.
+         * @return The original index of the point.
+         * @see sort_spatially()
+         */
+        inline std::size_t original_index( const DataPoint* p) const {
+            const std::size_t idx = index_of( p);
+            return _original_indices.empty() ? idx : _original_indices[idx];
+        }
+
+        /** Retrieves the number of points.
+         * @return The number of points.
+         */
+        inline std::size_t size() const { return _points.size(); }
+
+        /** Retrieves the dimensionality of the points.
+         * @return The dimensionality of the points.
+         */
+        inline unsigned int dim() const { return _dim; }
+
+        /** Retrieves pointers to all points, e.g. as the input of optics().
+         * The vector can be reordered, but the points must not be deleted.
+         * @return A reference to the vector of pointers to the points.
+         */
+        inline DataVector& points() { return _view; }
+
+        /** Retrieves pointers to all points.
+         * Constant method.
+         * @return A const reference to the vector of pointers to the points.
+         */
+        inline const DataVector& points() const { return _view; }
+
+        /** Retrieves the position of a point within the store.
+         * @param p A point of this store.
+         * @return The index of the point.
+         */
+        inline std::size_t index_of( const DataPoint* p) const {
+            assert( !_points.empty() && p >= &_points.front() && p <= &_points.back() && "The point must belong to this store.");
+            return static_cast<std::size_t>(p - &_points.front());
+        }
+
+    public: // operators
+
+        /** An index operator that retrieves the idx-th point.
+         * @param idx The index of the point. Must be within the range of the store.
+         * @return A reference to the point.
+         */
+        inline DataPoint& operator[]( const std::size_t idx) {
+            assert( _points.size()>idx && "Index must be within OPTICS::PointStore::_points' range.");
+            return _points[idx];
+        }
+
+        /** An index operator that retrieves the idx-th point.
+         * Constant method.
+         * @param idx The index of the point. Must be within the range of the store.
+         * @return A const reference to the point.
+         */
+        inline const DataPoint& operator[]( const std::size_t idx) const {
+            assert( _points.size()>idx && "Index must be within OPTICS::PointStore::_points' range.");
+            return _points[idx];
+        }
+    };
+
+} // END namespace OPTICS
@@ -0,0 +1,171 @@
+/******************************************************************************
+/* @file Contains a range query index for high-dimensional points that filters
+/*       candidates in a random low-dimensional projection.
+/*
+/*
+/* @author langenhagen
+/* @version 261016
+/******************************************************************************/
+#pragma once
+
+///////////////////////////////////////////////////////////////////////////////
+// INCLUDES project headers
+
+#include "kdtree.hpp"
+#include "optics.hpp"
+#include "point_store.hpp"
+#include "thread_pool.hpp"
+
+///////////////////////////////////////////////////////////////////////////////
+//INCLUDES C/C++ standard library (and other external libraries)
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+// NAMESPACE, CONSTANTS and TYPE DECLARATIONS/IMPLEMENTATIONS
+
+namespace OPTICS {
+
+    /** Implements an index for range queries over high-dimensional points by means of a
+     * Johnson-Lindenstrauss random projection.
+     * The points are projected once to a low dimension with a gaussian random matrix, scaled so that
+     * squared distances are preserved in expectation, and a KDTree is built over the projected copies.
+     * A query retrieves the points within eps times a slack factor in the projected space as
+     * candidates and verifies them with the exact squared_distance() in the original space.
+     * The neighborhoods therefore never contain false positives, and all reported distances are exact.
+     * A point within eps may however be projected further away than eps times the slack, and is then
+     * missed. The slack is the recall knob: the greater it is, the fewer neighbors are missed, and the
+     * more candidates are verified. A slack of about 1 + 3/sqrt(target_dim) misses few neighbors.
+     * Use it with optics_indexed(). The index keeps per-query scratch memory, so one index must not
+     * be queried concurrently.
+     */
+    class ProjectionIndex {
+
+    private: // vars
+
+        DataVector _db;                         ///< The indexed points.
+        unsigned int _dim;                      ///< The dimensionality of the indexed points.
+        unsigned int _target_dim;               ///< The dimensionality of the projected points.
+        real _slack;                            ///< The factor of eps within which projected points are candidates.
+        std::vector<real> _matrix;              ///< The projection matrix, _target_dim rows of _dim values.
+        PointStore _projected;                  ///< The projected points, in the order of _db.
+        KDTree _tree;                           ///< The index over the projected points.
+        mutable DataPoint _query;               ///< Scratch memory: the projection of the current query point.
+        mutable Neighborhood _candidates;       ///< Scratch memory: the candidates of the current query.
+
+    public: // ctor & dtor
+
+        /** Main constructor. Projects the points in O(n dim target_dim) and builds the KDTree.
+         * @param db The points to index. All points must have the same dimensionality.
+         * @param target_dim The dimensionality of the projection. Must be greater than 0.
+         * @param slack The factor of eps within which projected points are candidates. Must be at least 1.
+         * @param seed The seed of the random projection matrix.
+         * @param pool The thread pool that builds the KDTree.
+         */
+        ProjectionIndex( const DataVector& db, const unsigned int target_dim = 16, const real slack = 1.75f, const unsigned int seed = 42, ThreadPool& pool = default_pool())
+            : _db( db.begin(), db.end()), _dim( db.empty() ? 0 : static_cast<unsigned int>( db.front()->data().size())),
+              _target_dim( target_dim), _slack( slack), _matrix( generate_matrix( _dim, target_dim, seed)),
+              _projected( db.size(), target_dim), _tree( project_all( _db, _matrix, _dim, target_dim, _projected), 16, pool) {
+            assert( target_dim > 0 && "target_dim must be greater than 0");
+            assert( slack >= 1 && "slack must be at least 1");
+            _query.data().resize( target_dim);
+        }
+
+    private: // forbidden copy construction and assignment
+
+        ProjectionIndex( const ProjectionIndex&);
+        ProjectionIndex& operator=( const ProjectionIndex&);
+
+    public: // methods
+
+        /** Retrieves the indexed points within a given distance of a point.
+         * @param p The query point. Must have the dimensionality of the indexed points.
+         * @param eps The radius of the query.
+         * @param o_N_eps Receives the points within the radius around p whose projections are within
+         *        eps times the slack of the projection of p, including p itself if it is indexed,
+         *        together with their exact squared distances to p. The previous content is kept.
+         */
+        void range_query( const DataPoint* p, const real eps, Neighborhood& o_N_eps) const {
+            assert( eps >= 0 && "eps must not be negative");
+            assert( p->data().size() == _dim && "Query point must have the dimensionality of the indexed points");
+            const real eps_sq = eps*eps;
+            project( p->data().data(), _matrix, _dim, _target_dim, _query.data().data());
+
+            _candidates.clear();
+            const real radius = eps == OPTICS::UNDEFINED ? eps : eps * _slack;
+            _tree.range_query( &_query, radius, _candidates);
+            for( auto it=_candidates.begin(); it!=_candidates.end(); ++it) {
+                DataPoint* q = _db[_projected.index_of( it->point)];
+                const real d = squared_distance( p, q);
+                if( d <= eps_sq) {
+                    Neighbor n = { q, d };
+                    o_N_eps.push_back( n);
+                }
+            }
+        }
+
+        /** Retrieves the dimensionality of the projected points.
+         * @return The dimensionality of the projection.
+         */
+        inline unsigned int target_dim() const { return _target_dim; }
+
+        /** Retrieves the factor of eps within which projected points are candidates.
+         * @return The slack.
+         */
+        inline real slack() const { return _slack; }
+
+    private: // helpers
+
+        /** Generates a gaussian random projection matrix, scaled by 1/sqrt(target_dim).
+         * @param dim The dimensionality of the original points.
+         * @param target_dim The dimensionality of the projection.
+         * @param seed The seed of the random number generator.
+         * @return The matrix, target_dim rows of dim values.
+         */
+        static std::vector<real> generate_matrix( const unsigned int dim, const unsigned int target_dim, const unsigned int seed) {
+            std::mt19937 generator( seed);
+            std::normal_distribution<double> gaussian( 0.0, 1.0 / std::sqrt( static_cast<double>( target_dim)));
+            std::vector<real> ret( static_cast<std::size_t>( dim) * target_dim);
+            for( auto it=ret.begin(); it!=ret.end(); ++it)
+                *it = static_cast<real>( gaussian( generator));
+            return ret;
+        }
+
+        /** Projects the coordinates of a point.
+         * @param x The dim coordinates of the point.
+         * @param matrix The projection matrix.
+         * @param dim The dimensionality of the original point.
+         * @param target_dim The dimensionality of the projection.
+         * @param o_y Receives the target_dim projected coordinates.
+         */
+        static void project( const real* x, const std::vector<real>& matrix, const unsigned int dim, const unsigned int target_dim, real* o_y) {
+            for( unsigned int r=0; r<target_dim; ++r) {
+                const real* row = &matrix[static_cast<std::size_t>( r) * dim];
+                real sum = 0;
+                for( unsigned int k=0; k<dim; ++k)
+                    sum += row[k] * x[k];
+                o_y[r] = sum;
+            }
+        }
+
+        /** Projects all points into a store.
+         * @param db The points.
+         * @param matrix The projection matrix.
+         * @param dim The dimensionality of the original points.
+         * @param target_dim The dimensionality of the projection.
+         * @param o_projected Receives the projected points, in the order of db.
+         * @return The points of the store, for building the KDTree.
+         */
+        static const DataVector& project_all( const DataVector& db, const std::vector<real>& matrix, const unsigned int dim, const unsigned int target_dim, PointStore& o_projected) {
+            DataVector& ret = o_projected.points();
+            for( std::size_t i=0; i<db.size(); ++i) {
+                assert( db[i]->data().size() == dim && "All points must have the same dimensionality");
+                project( db[i]->data().data(), matrix, dim, target_dim, ret[i]->data().data());
+            }
+            return ret;
+        }
+    };
+
+} // END namespace OPTICS
@@ -0,0 +1,343 @@
+/******************************************************************************
+/* @file Contains the support of sparse high-dimensional points: a CSR-backed
+/*       point store, sparse distance kernels and an inverted index.
+/*
+/*
+/* @author langenhagen
+/* @version 261016
+/******************************************************************************/
+#pragma once
+
+///////////////////////////////////////////////////////////////////////////////
+// INCLUDES project headers
+
+#include "DataPoint.hpp"
+
+///////////////////////////////////////////////////////////////////////////////
+//INCLUDES C/C++ standard library (and other external libraries)
+
+#include <algorithm> // sort
+#include <cmath>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+// NAMESPACE, CONSTANTS and TYPE DECLARATIONS/IMPLEMENTATIONS
+
+namespace OPTICS {
+
+    /// The distances between sparse points.
+    enum SparseMetric {
+        SPARSE_EUCLIDEAN,   ///< The euclidean distance.
+        SPARSE_COSINE       ///< The cosine distance 1 - cos(a,b). Points with a norm of 0 have a cosine of 0 to all other points.
+    };
+
+
+    /** Implements a store of sparse points in compressed sparse row (CSR) format.
+     * Only the non-zero elements of every point are kept, sorted by dimension, together with the
+     * squared norm of every point, with one point per row.
+     * Run OPTICS on the points with optics_indexed() and a SparseIndex.
+     */
+    class SparseStore : public StatePoints {
+
+    private: // vars
+
+        std::uint32_t _dim;                     ///< The dimensionality of the points.
+        std::vector<std::size_t> _row_offsets;  ///< The non-zeros of row i are [_row_offsets[i], _row_offsets[i+1]).
+        std::vector<std::uint32_t> _columns;    ///< The dimension of every non-zero, ascending within a row.
+        std::vector<real> _values;              ///< The value of every non-zero.
+        std::vector<double> _squared_norms;     ///< The squared euclidean norm of every row.
+
+    public: // ctor & dtor
+
+        /// Default constructor. Creates an empty store.
+        SparseStore() : _dim( 0), _row_offsets( 1, 0)
+        {}
+
+        /** Main constructor.
+         * Creates the points from a matrix in CSR format. The non-zeros within a row can be in any
+         * order but must have distinct dimensions. Explicit zeros are dropped.
+         * @param row_offsets n+1 offsets; the non-zeros of row i are [row_offsets[i], row_offsets[i+1]).
+         * @param columns The dimension of every non-zero. Must be less than dim.
+         * @param values The value of every non-zero.
+         * @param n The number of rows, i.e. points.
+         * @param dim The dimensionality of the points.
+         */
+        SparseStore( const std::size_t* row_offsets, const std::uint32_t* columns, const real* values, const std::size_t n, const std::uint32_t dim)
+            : StatePoints( n), _dim( dim), _row_offsets( 1, 0) {
+            _row_offsets.reserve( n+1);
+            _columns.reserve( row_offsets[n] - row_offsets[0]);
+            _values.reserve( row_offsets[n] - row_offsets[0]);
+            _squared_norms.reserve( n);
+
+            std::vector<std::pair<std::uint32_t, real>> row;
+            for( std::size_t i=0; i<n; ++i) {
+                row.clear();
+                for( std::size_t k=row_offsets[i]; k<row_offsets[i+1]; ++k) {
+                    assert( columns[k] < dim && "Column must be less than the dimensionality");
+                    if( values[k] != 0)
+                        row.push_back( std::make_pair( columns[k], values[k]));
+                }
+                std::sort( row.begin(), row.end());
+
+                double squared_norm = 0;
+                for( auto it=row.begin(); it!=row.end(); ++it) {
+                    assert( (it == row.begin() || (it-1)->first != it->first) && "Dimensions within a row must be distinct");
+                    _columns.push_back( it->first);
+                    _values.push_back( it->second);
+                    squared_norm += static_cast<double>(it->second) * it->second;
+                }
+                _row_offsets.push_back( _columns.size());
+                _squared_norms.push_back( squared_norm);
+            }
+        }
+
+    public: // methods
+
+        /** Retrieves the dimensionality of the points.
+         * @return The dimensionality of the points.
+         */
+        inline std::uint32_t dim() const { return _dim; }
+
+        /** Retrieves the number of non-zeros of all points.
+         * @return The number of non-zeros.
+         */
+        inline std::size_t nnz() const { return _columns.size(); }
+
+        /** Retrieves the number of non-zeros of a point.
+         * @param idx The index of the point.
+         * @return The number of non-zeros.
+         */
+        inline std::size_t row_size( const std::size_t idx) const { return _row_offsets[idx+1] - _row_offsets[idx]; }
+
+        /** Retrieves the dimensions of the non-zeros of a point.
+         * @param idx The index of the point.
+         * @return A pointer to row_size(idx) ascending dimensions.
+         */
+        inline const std::uint32_t* columns( const std::size_t idx) const { return _columns.data() + _row_offsets[idx]; }
+
+        /** Retrieves the values of the non-zeros of a point.
+         * @param idx The index of the point.
+         * @return A pointer to row_size(idx) values, in the order of columns(idx).
+         */
+        inline const real* values( const std::size_t idx) const { return _values.data() + _row_offsets[idx]; }
+
+        /** Retrieves the squared euclidean norm of a point.
+         * @param idx The index of the point.
+         * @return The squared norm.
+         */
+        inline double squared_norm( const std::size_t idx) const { return _squared_norms[idx]; }
+    };
+
+
+
+    // FUNCTION DECLARATIONS ######################################################################
+
+    real sparse_squared_distance( const SparseStore& store, const std::size_t a, const std::size_t b, const SparseMetric metric);
+    double sparse_dot( const SparseStore& store, const std::size_t a, const std::size_t b);
+
+
+
+    // KERNELS ####################################################################################
+
+
+    /** Computes the squared distance between two sparse points by merging their non-zeros.
+     * Takes O(row_size(a) + row_size(b)) time.
+     * @param store The store of the points.
+     * @param a The index of the first point.
+     * @param b The index of the second point.
+     * @param metric The metric.
+     * @return The squared distance of the points.
+     */
+    real sparse_squared_distance( const SparseStore& store, const std::size_t a, const std::size_t b, const SparseMetric metric) {
+        if( metric == SPARSE_COSINE) {
+            if( a == b)
+                return 0;
+            const double norms = std::sqrt( store.squared_norm( a) * store.squared_norm( b));
+            const double cosine = norms > 0 ? sparse_dot( store, a, b) / norms : 0;
+            const double d = std::max( 0.0, 1.0 - cosine);
+            return static_cast<real>( d*d);
+        }
+
+        const std::uint32_t* ca = store.columns( a);
+        const std::uint32_t* cb = store.columns( b);
+        const real* va = store.values( a);
+        const real* vb = store.values( b);
+        const std::size_t na = store.row_size( a);
+        const std::size_t nb = store.row_size( b);
+        double ret = 0;
+        std::size_t i = 0, j = 0;
+        while( i < na && j < nb) {
+            double diff;
+            if( ca[i] == cb[j])
+                diff = static_cast<double>(va[i++]) - vb[j++];
+            else if( ca[i] < cb[j])
+                diff = va[i++];
+            else
+                diff = vb[j++];
+            ret += diff*diff;
+        }
+        for( ; i<na; ++i)
+            ret += static_cast<double>(va[i]) * va[i];
+        for( ; j<nb; ++j)
+            ret += static_cast<double>(vb[j]) * vb[j];
+        return static_cast<real>( ret);
+    }
+
+
+    /** Computes the dot product of two sparse points by merging their non-zeros.
+     * Takes O(row_size(a) + row_size(b)) time.
+     * @param store The store of the points.
+     * @param a The index of the first point.
+     * @param b The index of the second point.
+     * @return The dot product of the points.
+     */
+    double sparse_dot( const SparseStore& store, const std::size_t a, const std::size_t b) {
+        const std::uint32_t* ca = store.columns( a);
+        const std::uint32_t* cb = store.columns( b);
+        const real* va = store.values( a);
+        const real* vb = store.values( b);
+        const std::size_t na = store.row_size( a);
+        const std::size_t nb = store.row_size( b);
+        double ret = 0;
+        std::size_t i = 0, j = 0;
+        while( i < na && j < nb) {
+            if( ca[i] == cb[j])
+                ret += static_cast<double>(va[i++]) * vb[j++];
+            else if( ca[i] < cb[j])
+                ++i;
+            else
+                ++j;
+        }
+        return ret;
+    }
+
+
+
+    // INDEX ######################################################################################
+
+
+    /** Implements an inverted index over the points of a SparseStore for range queries.
+     * For every dimension, the index lists the points with a non-zero in it. The candidates of a query
+     * are the points that share a dimension with the query point; their distances are computed with
+     * the merge kernels. Points that share no dimension with the query point have a euclidean distance
+     * of sqrt(|p|^2 + |q|^2) and a cosine distance of 1. They are found without looking at their
+     * non-zeros: under the euclidean metric, from a list of all points sorted by norm; under the
+     * cosine metric, they are in range exactly if eps is at least 1.
+     * A query thus takes time proportional to the non-zeros of the candidates plus the size of the result.
+     * The index keeps per-query scratch memory, so one index must not be queried concurrently.
+     */
+    class SparseIndex {
+
+    private: // vars
+
+        SparseStore& _store;                        ///< The indexed points.
+        SparseMetric _metric;                       ///< The metric of the queries.
+        std::vector<std::size_t> _posting_offsets;  ///< The points of dimension d are _postings[_posting_offsets[d], _posting_offsets[d+1]).
+        std::vector<std::uint32_t> _postings;       ///< The indices of the points with a non-zero, dimension after dimension.
+        std::vector<std::uint32_t> _by_norm;        ///< The indices of all points, sorted by ascending norm.
+        mutable std::vector<std::uint32_t> _candidates; ///< Scratch memory: the candidates of the current query.
+        mutable std::vector<bool> _is_candidate;    ///< Scratch memory: whether a point is a candidate of the current query.
+
+    public: // ctor & dtor
+
+        /** Main constructor.
+         * Builds the index in O(nnz + dim + n log n).
+         * @param store The points to index.
+         * @param metric The metric of the queries.
+         */
+        explicit SparseIndex( SparseStore& store, const SparseMetric metric = SPARSE_EUCLIDEAN)
+            : _store( store), _metric( metric), _posting_offsets( store.dim() + 1, 0), _is_candidate( store.size(), false) {
+            const std::size_t n = store.size();
+
+            // count, prefix sum, fill
+            for( std::size_t i=0; i<n; ++i) {
+                for( std::size_t k=0; k<store.row_size( i); ++k)
+                    ++_posting_offsets[store.columns( i)[k] + 1];
+            }
+            for( std::uint32_t d=0; d<store.dim(); ++d)
+                _posting_offsets[d+1] += _posting_offsets[d];
+            _postings.resize( store.nnz());
+            std::vector<std::size_t> fill( _posting_offsets.begin(), _posting_offsets.end()-1);
+            for( std::size_t i=0; i<n; ++i) {
+                for( std::size_t k=0; k<store.row_size( i); ++k)
+                    _postings[fill[store.columns( i)[k]]++] = static_cast<std::uint32_t>(i);
+            }
+
+            _by_norm.resize( n);
+            for( std::size_t i=0; i<n; ++i)
+                _by_norm[i] = static_cast<std::uint32_t>(i);
+            std::sort( _by_norm.begin(), _by_norm.end(), [&store]( std::uint32_t a, std::uint32_t b) { return store.squared_norm( a) < store.squared_norm( b); });
+        }
+
+    private: // forbidden copy construction and assignment
+
+        SparseIndex( const SparseIndex&);
+        SparseIndex& operator=( const SparseIndex&);
+
+    public: // methods
+
+        /** Retrieves all indexed points within a given distance of a query point.
+         * @param p The query point. Must be a point of the indexed store.
+         * @param eps The radius of the query.
+         * @param o_N_eps Receives all points within the radius around p, including p itself,
+         *        together with their squared distances to p. The previous content is kept.
+         */
+        void range_query( const DataPoint* p, const real eps, Neighborhood& o_N_eps) const {
+            assert( eps >= 0 && "eps must not be negative");
+            const std::size_t a = _store.index_of( p);
+            const real eps_sq = eps*eps;
+            DataVector& points = _store.points();
+
+            // candidates share at least one dimension with p
+            _candidates.clear();
+            const std::uint32_t* columns = _store.columns( a);
+            for( std::size_t k=0; k<_store.row_size( a); ++k) {
+                for( std::size_t i=_posting_offsets[columns[k]]; i<_posting_offsets[columns[k]+1]; ++i) {
+                    const std::uint32_t b = _postings[i];
+                    if( !_is_candidate[b]) {
+                        _is_candidate[b] = true;
+                        _candidates.push_back( b);
+                    }
+                }
+            }
+            for( auto it=_candidates.begin(); it!=_candidates.end(); ++it) {
+                const real d = sparse_squared_distance( _store, a, *it, _metric);
+                if( d <= eps_sq) {
+                    Neighbor n = { points[*it], d };
+                    o_N_eps.push_back( n);
+                }
+            }
+
+            // all other points are orthogonal to p
+            if( _metric == SPARSE_EUCLIDEAN) {
+                const double norm_a = _store.squared_norm( a);
+                for( auto it=_by_norm.begin(); it!=_by_norm.end(); ++it) {
+                    const real d = static_cast<real>( norm_a + _store.squared_norm( *it));
+                    if( d > eps_sq)
+                        break;
+                    if( !_is_candidate[*it]) {
+                        Neighbor n = { points[*it], d };
+                        o_N_eps.push_back( n);
+                    }
+                }
+            } else if( eps_sq >= 1) {
+                for( std::size_t b=0; b<_store.size(); ++b) {
+                    if( !_is_candidate[b]) {
+                        Neighbor n = { points[b], b == a ? real(0) : real(1) };
+                        o_N_eps.push_back( n);
+                    }
+                }
+            } else if( !_is_candidate[a]) {
+                // *** p has a norm of 0 ***
+                Neighbor n = { points[a], 0 };
+                o_N_eps.push_back( n);
+            }
+
+            for( auto it=_candidates.begin(); it!=_candidates.end(); ++it)
+                _is_candidate[*it] = false;
+        }
+    };
+
+} // END namespace OPTICS
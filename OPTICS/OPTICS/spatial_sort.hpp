@@ -0,0 +1,171 @@
+/******************************************************************************
+/* @file Contains space-filling curve keys (Morton/Z-order and Hilbert) for
+/*       DataPoints, which serve to order points by spatial locality.
+/*
+/*
+/* @author langenhagen
+/* @version 261016
+/******************************************************************************/
+#pragma once
+
+///////////////////////////////////////////////////////////////////////////////
+// INCLUDES project headers
+
+#include "DataPoint.hpp"
+
+///////////////////////////////////////////////////////////////////////////////
+//INCLUDES C/C++ standard library (and other external libraries)
+
+#include <algorithm> // sort
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+// NAMESPACE, CONSTANTS and TYPE DECLARATIONS/IMPLEMENTATIONS
+
+namespace OPTICS {
+
+    /// The space-filling curves that points can be ordered along.
+    enum SpaceFillingCurve {
+        MORTON,     ///< The Morton curve (Z-order). Cheap to compute.
+        HILBERT     ///< The Hilbert curve. Slightly more expensive, but without the long jumps of the Morton curve.
+    };
+
+
+    // FUNCTION DECLARATIONS ######################################################################
+
+    std::vector<std::uint64_t> space_filling_curve_keys( const DataVector& db, const SpaceFillingCurve curve);
+    std::vector<std::size_t> spatial_order( const DataVector& db, const SpaceFillingCurve curve);
+
+    // helpers
+    void hilbert_transpose( std::vector<std::uint32_t>& x, const unsigned int bits);
+    std::uint64_t interleave_bits( const std::vector<std::uint32_t>& x, const unsigned int bits);
+
+
+
+    // FUNCTIONS ##################################################################################
+
+
+    /** Computes the position of every point along a space-filling curve.
+     * The coordinates are quantized within the bounding box of all points to 64/dim bits per
+     * dimension. Points with more than 64 dimensions are ordered along their first 64 dimensions.
+     * @param db The points. All points must have the same dimensionality.
+     * @param curve The space-filling curve.
+     * @return One key per point, in the order of db. Points that are close to each other
+     *         in space tend to have close keys.
+     */
+    std::vector<std::uint64_t> space_filling_curve_keys( const DataVector& db, const SpaceFillingCurve curve) {
+        std::vector<std::uint64_t> ret( db.size(), 0);
+        if( db.empty() || db.front()->data().empty())
+            return ret;
+
+        const unsigned int dim = static_cast<unsigned int>( std::min<std::size_t>( 64, db.front()->data().size()));
+        const unsigned int bits = std::min( 32u, 64 / dim);
+        const double max_cell = static_cast<double>( (std::uint64_t(1) << bits) - 1);
+
+        // find the bounding box
+        std::vector<real> lo( dim, OPTICS::UNDEFINED);
+        std::vector<real> hi( dim, -OPTICS::UNDEFINED);
+        for( auto it=db.begin(); it!=db.end(); ++it) {
+            assert( (*it)->data().size() == db.front()->data().size() && "All DataPoints must have same dimensionality");
+            for( unsigned int d=0; d<dim; ++d) {
+                lo[d] = std::min( lo[d], (**it)[d]);
+                hi[d] = std::max( hi[d], (**it)[d]);
+            }
+        }
+        std::vector<double> scale( dim);
+        for( unsigned int d=0; d<dim; ++d)
+            scale[d] = hi[d] > lo[d] ? max_cell / (static_cast<double>(hi[d]) - lo[d]) : 0;
+
+        // quantize and map
+        std::vector<std::uint32_t> cell( dim);
+        for( std::size_t i=0; i<db.size(); ++i) {
+            const DataPoint& p = *db[i];
+            for( unsigned int d=0; d<dim; ++d)
+                cell[d] = static_cast<std::uint32_t>( std::min( max_cell, (static_cast<double>(p[d]) - lo[d]) * scale[d]));
+
+            if( curve == HILBERT)
+                hilbert_transpose( cell, bits);
+            ret[i] = interleave_bits( cell, bits);
+        }
+        return ret;
+    }
+
+
+    /** Computes the order of the points along a space-filling curve.
+     * @param db The points. All points must have the same dimensionality.
+     * @param curve The space-filling curve.
+     * @return A permutation of the indices of db: the i-th element is the index of the point
+     *         at the i-th position along the curve. Points with equal keys keep their relative order.
+     */
+    std::vector<std::size_t> spatial_order( const DataVector& db, const SpaceFillingCurve curve) {
+        const std::vector<std::uint64_t> keys = space_filling_curve_keys( db, curve);
+
+        std::vector<std::pair<std::uint64_t, std::size_t>> keyed( db.size());
+        for( std::size_t i=0; i<db.size(); ++i)
+            keyed[i] = std::make_pair( keys[i], i);
+        std::sort( keyed.begin(), keyed.end());
+
+        std::vector<std::size_t> ret( db.size());
+        for( std::size_t i=0; i<db.size(); ++i)
+            ret[i] = keyed[i].second;
+        return ret;
+    }
+
+
+
+    // HELPERS ####################################################################################
+
+
+    /** Transforms quantized coordinates in place into the transposed Hilbert index,
+     * following J. Skilling, "Programming the Hilbert curve" (2004).
+     * @param x The quantized coordinates, one per dimension.
+     * @param bits The number of bits per coordinate.
+     */
+    void hilbert_transpose( std::vector<std::uint32_t>& x, const unsigned int bits) {
+        const std::size_t n = x.size();
+        const std::uint32_t m = std::uint32_t(1) << (bits-1);
+
+        // inverse undo
+        for( std::uint32_t q=m; q>1; q>>=1) {
+            const std::uint32_t p = q-1;
+            for( std::size_t i=0; i<n; ++i) {
+                if( x[i] & q) {
+                    x[0] ^= p;
+                } else {
+                    const std::uint32_t t = (x[0] ^ x[i]) & p;
+                    x[0] ^= t;
+                    x[i] ^= t;
+                }
+            }
+        }
+
+        // gray encode
+        for( std::size_t i=1; i<n; ++i)
+            x[i] ^= x[i-1];
+        std::uint32_t t = 0;
+        for( std::uint32_t q=m; q>1; q>>=1) {
+            if( x[n-1] & q)
+                t ^= q-1;
+        }
+        for( std::size_t i=0; i<n; ++i)
+            x[i] ^= t;
+    }
+
+
+    /** Interleaves the bits of several values, most significant bits first.
+     * @param x The values.
+     * @param bits The number of bits per value. The product of bits and the number of values must not exceed 64.
+     * @return The interleaved bits.
+     */
+    std::uint64_t interleave_bits( const std::vector<std::uint32_t>& x, const unsigned int bits) {
+        std::uint64_t ret = 0;
+        for( unsigned int b=bits; b-->0; ) {
+            for( std::size_t i=0; i<x.size(); ++i)
+                ret = (ret << 1) | ((x[i] >> b) & 1);
+        }
+        return ret;
+    }
+
+} // END namespace OPTICS
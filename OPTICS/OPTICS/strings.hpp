@@ -0,0 +1,256 @@
+/******************************************************************************
+/* @file Contains a store of strings, the Levenshtein edit distance and a
+/*       BK-tree for range queries over the strings.
+/*
+/*
+/* @author langenhagen
+/* @version 261016
+/******************************************************************************/
+#pragma once
+
+///////////////////////////////////////////////////////////////////////////////
+// INCLUDES project headers
+
+#include "DataPoint.hpp"
+
+///////////////////////////////////////////////////////////////////////////////
+//INCLUDES C/C++ standard library (and other external libraries)
+
+#include <algorithm> // min, max
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+// NAMESPACE, CONSTANTS and TYPE DECLARATIONS/IMPLEMENTATIONS
+
+namespace OPTICS {
+
+    /** Implements a store of strings, e.g. log message templates.
+     * The characters of all strings are kept in one buffer, with one point per string.
+     * Run OPTICS on the points with optics_indexed() and a BKTree.
+     */
+    class StringStore : public StatePoints {
+
+    private: // vars
+
+        std::vector<char> _chars;           ///< The characters of all strings, one string after another.
+        std::vector<std::size_t> _offsets;  ///< String i is _chars[_offsets[i], _offsets[i+1]).
+
+    public: // ctor & dtor
+
+        /** Main constructor.
+         * @param strings The strings. They are copied.
+         */
+        explicit StringStore( const std::vector<std::string>& strings)
+            : StatePoints( strings.size()), _offsets( 1, 0) {
+            _offsets.reserve( strings.size() + 1);
+            for( auto it=strings.begin(); it!=strings.end(); ++it) {
+                _chars.insert( _chars.end(), it->begin(), it->end());
+                _offsets.push_back( _chars.size());
+            }
+        }
+
+    public: // methods
+
+        /** Retrieves the characters of a string.
+         * @param idx The index of the string.
+         * @return A pointer to length(idx) characters, not null-terminated.
+         */
+        inline const char* chars( const std::size_t idx) const { return _chars.data() + _offsets[idx]; }
+
+        /** Retrieves the length of a string.
+         * @param idx The index of the string.
+         * @return The number of characters.
+         */
+        inline std::size_t length( const std::size_t idx) const { return _offsets[idx+1] - _offsets[idx]; }
+    };
+
+
+
+    // FUNCTION DECLARATIONS ######################################################################
+
+    std::uint32_t levenshtein_distance( const char* a, const std::size_t n_a, const char* b, const std::size_t n_b, const std::uint32_t max_distance, std::vector<std::uint32_t>& buffer);
+
+
+
+    // KERNELS ####################################################################################
+
+
+    /** Computes the Levenshtein distance between two strings, i.e. the minimum number of insertions,
+     * deletions and substitutions of characters that turn one string into the other.
+     * Only the diagonal band of width 2*max_distance+1 of the dynamic programming matrix is
+     * computed, since a path outside of it costs more than max_distance, and the computation stops
+     * as soon as a whole row exceeds max_distance. Takes O(min(n_a, n_b) * max_distance) time.
+     * @param a The first string.
+     * @param n_a The length of the first string.
+     * @param b The second string.
+     * @param n_b The length of the second string.
+     * @param max_distance The maximum distance of interest.
+     * @param buffer A scratch buffer for two rows of the matrix. Its content is overwritten.
+     * @return The distance, or max_distance+1 if the distance exceeds max_distance (saturated at the maximum of std::uint32_t).
+     */
+    std::uint32_t levenshtein_distance( const char* a, const std::size_t n_a, const char* b, const std::size_t n_b, const std::uint32_t max_distance, std::vector<std::uint32_t>& buffer) {
+        if( n_a < n_b)
+            return levenshtein_distance( b, n_b, a, n_a, max_distance, buffer); // *** the rows span the shorter string ***
+        const std::uint32_t too_far = max_distance == std::numeric_limits<std::uint32_t>::max() ? max_distance : max_distance + 1;
+        // *** the distance never exceeds n_a, so a wider band is pointless ***
+        const std::size_t k = std::min<std::size_t>( max_distance, n_a);
+        if( n_a - n_b > k)
+            return too_far;
+
+        const std::uint32_t outside = static_cast<std::uint32_t>( k) + 1; // the value of all cells beyond the band
+        buffer.assign( 2*(n_b+1), outside);
+        std::uint32_t* prev = &buffer[0];
+        std::uint32_t* curr = &buffer[n_b+1];
+        for( std::size_t j=0; j<=std::min( n_b, k); ++j)
+            prev[j] = static_cast<std::uint32_t>( j);
+
+        for( std::size_t i=1; i<=n_a; ++i) {
+            const std::size_t lo = i > k ? i - k : 1;
+            const std::size_t hi = std::min( n_b, i + k);
+            curr[lo-1] = lo == 1 ? static_cast<std::uint32_t>( i) : outside;
+            std::uint32_t row_min = curr[lo-1];
+
+            for( std::size_t j=lo; j<=hi; ++j) {
+                const std::uint32_t substitution = prev[j-1] + (a[i-1] != b[j-1] ? 1 : 0);
+                const std::uint32_t deletion = prev[j] + 1;
+                const std::uint32_t insertion = curr[j-1] + 1;
+                curr[j] = std::min( outside, std::min( substitution, std::min( deletion, insertion)));
+                row_min = std::min( row_min, curr[j]);
+            }
+            if( hi < n_b)
+                curr[hi+1] = outside;
+            if( row_min > max_distance)
+                return too_far;
+            std::swap( prev, curr);
+        }
+        return prev[n_b] > max_distance ? too_far : prev[n_b];
+    }
+
+
+
+    // INDEX ######################################################################################
+
+
+    /** Implements a BK-tree over the strings of a StringStore for range queries under the
+     * Levenshtein distance.
+     * Every node holds a string, and its children are labelled with their distance to it. By the
+     * triangle inequality, the strings within distance r of the query are in the subtrees of the
+     * children whose label differs by at most r from the distance between the query and the node.
+     * The distance to a node is only needed up to r plus its largest child label, which lets the
+     * banded Levenshtein kernel stop early.
+     * Edit distances are integers; they are squared like all distances in the OPTICS module.
+     * The index keeps per-query scratch memory, so one index must not be queried concurrently.
+     */
+    class BKTree {
+
+    private: // types
+
+        /// A node of the tree.
+        struct Node {
+            std::uint32_t string;       ///< The index of the string of the node.
+            std::uint32_t distance;     ///< The distance to the parent, i.e. the label of the node.
+            std::uint32_t max_child;    ///< The largest label of the children.
+            std::uint32_t first_child;  ///< The first child, or NONE.
+            std::uint32_t next_sibling; ///< The next child of the parent, or NONE.
+        };
+
+        static const std::uint32_t NONE = 0xffffffffu; ///< The invalid node index.
+
+    private: // vars
+
+        StringStore& _store;                ///< The indexed strings.
+        std::vector<Node> _nodes;           ///< The nodes, the root first.
+        mutable std::vector<std::uint32_t> _stack;  ///< Scratch memory: the nodes to visit.
+        mutable std::vector<std::uint32_t> _buffer; ///< Scratch memory: the rows of the Levenshtein kernel.
+
+    public: // ctor & dtor
+
+        /** Main constructor. Inserts all strings in the order of the store.
+         * @param store The strings to index.
+         */
+        explicit BKTree( StringStore& store) : _store( store) {
+            _nodes.reserve( store.size());
+            for( std::size_t i=0; i<store.size(); ++i)
+                insert( static_cast<std::uint32_t>( i));
+        }
+
+    private: // forbidden copy construction and assignment
+
+        BKTree( const BKTree&);
+        BKTree& operator=( const BKTree&);
+
+    public: // methods
+
+        /** Retrieves all indexed strings within a given edit distance of a query string.
+         * @param p The query point. Must be a point of the indexed store.
+         * @param eps The radius of the query in edits.
+         * @param o_N_eps Receives all points within the radius around p, including p itself,
+         *        together with their squared edit distances to p. The previous content is kept.
+         */
+        void range_query( const DataPoint* p, const real eps, Neighborhood& o_N_eps) const {
+            assert( eps >= 0 && "eps must not be negative");
+            if( _nodes.empty())
+                return;
+            const std::size_t a = _store.index_of( p);
+            const std::uint32_t r = eps >= static_cast<real>( std::numeric_limits<std::uint32_t>::max() / 2)
+                ? std::numeric_limits<std::uint32_t>::max() / 2 : static_cast<std::uint32_t>( eps);
+            DataVector& points = _store.points();
+
+            _stack.assign( 1, 0);
+            while( !_stack.empty()) {
+                const Node& node = _nodes[_stack.back()];
+                _stack.pop_back();
+
+                const std::uint32_t d = levenshtein_distance( _store.chars( a), _store.length( a),
+                    _store.chars( node.string), _store.length( node.string), r + node.max_child, _buffer);
+                if( d <= r) {
+                    Neighbor n = { points[node.string], static_cast<real>( d) * d };
+                    o_N_eps.push_back( n);
+                }
+                for( std::uint32_t c=node.first_child; c!=NONE; c=_nodes[c].next_sibling) {
+                    const std::uint32_t label = _nodes[c].distance;
+                    if( label + r >= d && label <= d + r)
+                        _stack.push_back( c);
+                }
+            }
+        }
+
+    private: // helpers
+
+        /** Inserts a string into the tree.
+         * @param idx The index of the string.
+         */
+        void insert( const std::uint32_t idx) {
+            Node leaf = { idx, 0, 0, NONE, NONE };
+            if( _nodes.empty()) {
+                _nodes.push_back( leaf);
+                return;
+            }
+
+            std::uint32_t current = 0;
+            for( ;;) {
+                const std::uint32_t d = levenshtein_distance( _store.chars( idx), _store.length( idx),
+                    _store.chars( _nodes[current].string), _store.length( _nodes[current].string), std::numeric_limits<std::uint32_t>::max(), _buffer);
+
+                std::uint32_t c = _nodes[current].first_child;
+                while( c != NONE && _nodes[c].distance != d)
+                    c = _nodes[c].next_sibling;
+                if( c != NONE) {
+                    current = c;
+                    continue;
+                }
+
+                leaf.distance = d;
+                leaf.next_sibling = _nodes[current].first_child;
+                _nodes[current].first_child = static_cast<std::uint32_t>( _nodes.size());
+                _nodes[current].max_child = std::max( _nodes[current].max_child, d);
+                _nodes.push_back( leaf);
+                return;
+            }
+        }
+    };
+
+} // END namespace OPTICS
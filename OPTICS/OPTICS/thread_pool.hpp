@@ -0,0 +1,338 @@
+/******************************************************************************
+/* @file Contains the ThreadPool class, a persistent work-stealing scheduler
+/*       that the parallel phases of the OPTICS module run on.
+/*
+/*
+/* @author langenhagen
+/* @version 261016
+/******************************************************************************/
+#pragma once
+
+///////////////////////////////////////////////////////////////////////////////
+//INCLUDES C/C++ standard library (and other external libraries)
+
+#include <algorithm> // min, max
+#include <atomic>
+#include <cassert>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#if defined(_WIN32)
+    #ifndef NOMINMAX
+        #define NOMINMAX
+    #endif
+    #include <windows.h>
+#elif defined(__linux__)
+    #include <pthread.h>
+    #include <sched.h>
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+// NAMESPACE, CONSTANTS and TYPE DECLARATIONS/IMPLEMENTATIONS
+
+namespace OPTICS {
+
+    /** Implements a pool of persistent worker threads with work stealing.
+     * Every worker has a task queue of its own. A worker takes tasks from the back of its own queue
+     * and, when it runs dry, steals from the front of the other queues. Tasks submitted from outside
+     * the pool are distributed round-robin. The threads are started once and live as long as the pool,
+     * so that a long-running process can run many short OPTICS calls without spawning threads per call.
+     * Threads that wait for a parallel_for() to finish execute pending tasks meanwhile, so parallel
+     * phases can be nested and a pool without workers runs everything on the calling thread.
+     */
+    class ThreadPool {
+
+    private: // types
+
+        /// The task queue of one worker.
+        struct TaskQueue {
+            std::mutex mutex;                           ///< Guards the tasks.
+            std::deque<std::function<void()>> tasks;    ///< The pending tasks.
+        };
+
+        /// Identifies the pool and worker the current thread belongs to.
+        struct WorkerId {
+            const ThreadPool* pool; ///< The pool of the current thread, or nullptr if it is no worker.
+            unsigned int index;     ///< The index of the worker within its pool.
+        };
+
+    private: // vars
+
+        std::vector<std::unique_ptr<TaskQueue>> _queues; ///< One task queue per worker.
+        std::vector<std::thread> _threads;      ///< The worker threads.
+        std::mutex _mutex;                      ///< Guards sleeping, waking and _stop.
+        std::condition_variable _wake;          ///< Wakes sleeping workers when tasks are submitted or the pool stops.
+        std::atomic<std::size_t> _n_pending;    ///< The number of tasks that are queued and not yet taken.
+        std::atomic<unsigned int> _next_queue;  ///< The queue that receives the next task submitted from outside.
+        bool _stop;                             ///< Whether the workers should terminate.
+
+    public: // ctor & dtor
+
+        /** Main constructor.
+         * Starts the worker threads.
+         * @param n_threads The number of worker threads. If 0, all tasks are run by the threads that wait for them.
+         * @param cpu_affinity The CPUs to pin the workers to. The i-th worker is pinned to the
+         *        (i modulo size)-th CPU of the list. If empty, the workers are not pinned.
+         *        Pinning is supported on Windows and Linux and ignored elsewhere.
+         */
+        explicit ThreadPool( const unsigned int n_threads = std::thread::hardware_concurrency(),
+                             const std::vector<int>& cpu_affinity = std::vector<int>())
+            : _n_pending( 0), _next_queue( 0), _stop( false) {
+            start( n_threads, cpu_affinity);
+        }
+
+        /// Destructor. Finishes all pending tasks and joins the worker threads.
+        ~ThreadPool() {
+            stop();
+        }
+
+    private: // forbidden copy construction and assignment; the workers refer to this object
+
+        ThreadPool( const ThreadPool&);
+        ThreadPool& operator=( const ThreadPool&);
+
+    public: // methods
+
+        /** Restarts the pool with a different configuration.
+         * Finishes all pending tasks first. Must not be called from within a task
+         * nor while another thread uses the pool.
+         * @param n_threads The number of worker threads.
+         * @param cpu_affinity The CPUs to pin the workers to. If empty, the workers are not pinned.
+         */
+        void reset( const unsigned int n_threads, const std::vector<int>& cpu_affinity = std::vector<int>()) {
+            stop();
+            start( n_threads, cpu_affinity);
+        }
+
+        /** Retrieves the number of worker threads.
+         * @return The number of worker threads.
+         */
+        inline unsigned int size() const { return static_cast<unsigned int>(_threads.size()); }
+
+        /** Schedules a task for execution on a worker thread.
+         * Submitted from a worker of this pool, the task goes to the worker's own queue.
+         * @param task The task.
+         */
+        void submit( std::function<void()> task) {
+            if( _queues.empty()) {
+                // *** no workers; run it right away ***
+                task();
+                return;
+            }
+
+            const WorkerId& self = current_worker();
+            const unsigned int q = self.pool == this ? self.index : _next_queue++ % static_cast<unsigned int>(_queues.size());
+            {
+                // *** count first, so that the counter never drops below the number of queued tasks ***
+                std::lock_guard<std::mutex> lock( _mutex);
+                ++_n_pending;
+            }
+            {
+                std::lock_guard<std::mutex> lock( _queues[q]->mutex);
+                _queues[q]->tasks.push_back( std::move( task));
+            }
+            _wake.notify_one();
+        }
+
+        /** Takes one pending task, if any, and runs it on the calling thread.
+         * Workers prefer their own queue; all other threads steal from any queue.
+         * @return true if a task was run, false if no task was pending.
+         */
+        bool run_pending_task() {
+            std::function<void()> task;
+            const WorkerId& self = current_worker();
+            if( !take( self.pool == this ? static_cast<int>(self.index) : -1, task))
+                return false;
+            task();
+            return true;
+        }
+
+        /** Calls a function on consecutive chunks of an index range in parallel and waits for all chunks.
+         * The calling thread processes chunks as well.
+         * @param begin The first index.
+         * @param end The index behind the last index.
+         * @param grain_size The minimum number of indices per chunk. Must be greater than 0.
+         * @param body The function. It is called with the first index of a chunk and the index behind its last index.
+         *        Chunks are disjoint and cover the range; they may run in any order.
+         */
+        void parallel_for( const std::size_t begin,
+                           const std::size_t end,
+                           const std::size_t grain_size,
+                           const std::function<void(std::size_t, std::size_t)>& body) {
+            assert( grain_size > 0 && "grain_size must be greater than 0");
+            if( end <= begin)
+                return;
+
+            // a few chunks per thread, so that uneven chunks can be balanced by stealing
+            const std::size_t n = end - begin;
+            const std::size_t max_chunks = std::max<std::size_t>( 1, 4 * (size() + 1));
+            const std::size_t chunk_size = std::max( grain_size, (n + max_chunks - 1) / max_chunks);
+            const std::size_t n_chunks = (n + chunk_size - 1) / chunk_size;
+            if( n_chunks == 1) {
+                body( begin, end);
+                return;
+            }
+
+            std::atomic<std::size_t> n_remaining( n_chunks - 1);
+            for( std::size_t c=1; c<n_chunks; ++c) {
+                const std::size_t lower = begin + c*chunk_size;
+                const std::size_t upper = std::min( end, lower + chunk_size);
+                submit( [&body, &n_remaining, lower, upper]() {
+                    body( lower, upper);
+                    --n_remaining;
+                });
+            }
+            body( begin, std::min( end, begin + chunk_size));
+
+            while( n_remaining > 0) {
+                if( !run_pending_task())
+                    std::this_thread::yield();
+            }
+        }
+
+    private: // helpers
+
+        /** Starts the worker threads.
+         * @param n_threads The number of worker threads.
+         * @param cpu_affinity The CPUs to pin the workers to. If empty, the workers are not pinned.
+         */
+        void start( const unsigned int n_threads, const std::vector<int>& cpu_affinity) {
+            _stop = false;
+            _queues.clear();
+            for( unsigned int i=0; i<n_threads; ++i)
+                _queues.push_back( std::unique_ptr<TaskQueue>( new TaskQueue()));
+
+            _threads.reserve( n_threads);
+            for( unsigned int i=0; i<n_threads; ++i) {
+                _threads.push_back( std::thread( &ThreadPool::work, this, i));
+                if( !cpu_affinity.empty())
+                    pin( _threads.back(), cpu_affinity[i % cpu_affinity.size()]);
+            }
+        }
+
+        /// Finishes all pending tasks and joins the worker threads.
+        void stop() {
+            {
+                std::lock_guard<std::mutex> lock( _mutex);
+                _stop = true;
+            }
+            _wake.notify_all();
+            for( auto it=_threads.begin(); it!=_threads.end(); ++it)
+                it->join();
+            _threads.clear();
+        }
+
+        /** Removes a pending task from the queues.
+         * @param own The queue to look into first, taking its newest task, or -1.
+         *        The other queues are stolen from, taking their oldest tasks.
+         * @param o_task Receives the task.
+         * @return true if a task was found, false otherwise.
+         */
+        bool take( const int own, std::function<void()>& o_task) {
+            if( _n_pending == 0)
+                return false;
+
+            const unsigned int n = static_cast<unsigned int>(_queues.size());
+            if( own >= 0) {
+                TaskQueue& q = *_queues[own];
+                std::lock_guard<std::mutex> lock( q.mutex);
+                if( !q.tasks.empty()) {
+                    o_task = std::move( q.tasks.back());
+                    q.tasks.pop_back();
+                    --_n_pending;
+                    return true;
+                }
+            }
+            for( unsigned int i=1; i<=n; ++i) {
+                const unsigned int victim = (static_cast<unsigned int>(own+1) + i) % n;
+                TaskQueue& q = *_queues[victim];
+                std::lock_guard<std::mutex> lock( q.mutex);
+                if( !q.tasks.empty()) {
+                    o_task = std::move( q.tasks.front());
+                    q.tasks.pop_front();
+                    --_n_pending;
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        /** The loop of a worker thread. Runs tasks until the pool stops and no task is pending.
+         * @param index The index of the worker.
+         */
+        void work( const unsigned int index) {
+            WorkerId& self = current_worker();
+            self.pool = this;
+            self.index = index;
+
+            std::function<void()> task;
+            for(;;) {
+                if( take( static_cast<int>(index), task)) {
+                    task();
+                    task = nullptr;
+                    continue;
+                }
+
+                std::unique_lock<std::mutex> lock( _mutex);
+                _wake.wait( lock, [this]() { return _stop || _n_pending > 0; });
+                if( _stop && _n_pending == 0)
+                    break;
+            }
+            self.pool = nullptr;
+        }
+
+        /** Pins a thread to a CPU.
+         * @param t The thread.
+         * @param cpu The index of the CPU.
+         */
+        static void pin( std::thread& t, const int cpu) {
+#if defined(_WIN32)
+            SetThreadAffinityMask( t.native_handle(), DWORD_PTR(1) << cpu);
+#elif defined(__linux__)
+            cpu_set_t cpus;
+            CPU_ZERO( &cpus);
+            CPU_SET( cpu, &cpus);
+            pthread_setaffinity_np( t.native_handle(), sizeof( cpu_set_t), &cpus);
+#else
+            (void)t;
+            (void)cpu;
+#endif
+        }
+
+        /** Retrieves the identity of the current thread.
+         * @return A reference to the thread local identity of the current thread.
+         */
+        static WorkerId& current_worker() {
+            static thread_local WorkerId id = { nullptr, 0 };
+            return id;
+        }
+    };
+
+
+    /** Retrieves the pool that the parallel phases of the OPTICS module run on by default.
+     * The pool is created with one worker per hardware thread on first use and lives until the
+     * program ends. Call reset() on it once at startup to configure the thread count and affinity.
+     * @return A reference to the default pool.
+     */
+    inline ThreadPool& default_pool() {
+        static ThreadPool pool;
+        return pool;
+    }
+
+
+    /** Retrieves a pool without workers, on which parallel phases run entirely on the calling thread.
+     * Single-threaded entry points like optics() use it, so that they never start threads.
+     * The pool holds no tasks, so any number of threads can use it at once.
+     * @return A reference to the serial pool.
+     */
+    inline ThreadPool& serial_pool() {
+        static ThreadPool pool( 0);
+        return pool;
+    }
+
+} // END namespace OPTICS
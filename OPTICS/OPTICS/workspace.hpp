@@ -0,0 +1,193 @@
+/******************************************************************************
+/* @file Contains the reusable scratch memory of OPTICS runs: the seed list
+/*       and the Workspace class.
+/*
+/*
+/* @author langenhagen
+/* @version 261016
+/******************************************************************************/
+#pragma once
+
+///////////////////////////////////////////////////////////////////////////////
+// INCLUDES project headers
+
+#include "DataPoint.hpp"
+
+///////////////////////////////////////////////////////////////////////////////
+//INCLUDES C/C++ standard library (and other external libraries)
+
+#include <algorithm> // push_heap, pop_heap
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+// NAMESPACE, CONSTANTS and TYPE DECLARATIONS/IMPLEMENTATIONS
+
+namespace OPTICS {
+
+    /** Implements the seeds priority queue of the OPTICS algorithm as a binary heap on a vector.
+     * Instead of a decrease-key operation, a point whose reachability distance has been lowered
+     * is pushed again. Outdated entries are recognized by their reachability distance and dropped
+     * when they reach the top. Points are popped in the same order as from a DataSet, i.e. by
+     * reachability distance and then by address. Once the vector has grown, no more allocations happen.
+     */
+    class SeedHeap {
+
+    private: // types
+
+        /// A heap entry: a point and the reachability distance it had when it was pushed.
+        struct Entry {
+            real reachability_distance; ///< The reachability distance of the point when it was pushed.
+            DataPoint* point;           ///< The point.
+        };
+
+        /// Heap order: the entry with the smallest reachability distance, then the smallest address, is on top.
+        struct Comp_Entry_f {
+            bool operator() ( const Entry& lhs, const Entry& rhs) const {
+                return lhs.reachability_distance > rhs.reachability_distance
+                    || (lhs.reachability_distance == rhs.reachability_distance && lhs.point > rhs.point);
+            }
+        };
+
+        /// Heap order on positions within the heap, according to the entries at these positions.
+        struct Comp_Candidate_f {
+            const std::vector<Entry, Allocator<Entry>::type>* heap;
+            bool operator() ( const std::size_t lhs, const std::size_t rhs) const {
+                return Comp_Entry_f()( (*heap)[lhs], (*heap)[rhs]);
+            }
+        };
+
+    private: // vars
+
+        std::vector<Entry, Allocator<Entry>::type> _heap; ///< The heap entries, including outdated ones.
+        std::vector<std::size_t, Allocator<std::size_t>::type> _candidates; ///< The scratch memory of top(): heap positions, ordered as a heap themselves.
+
+    public: // ctor & dtor
+
+        /// Default constructor. Creates an empty seed list.
+        SeedHeap()
+        {}
+
+        /** Allocator-aware constructor. Creates an empty seed list.
+         * @param alloc The allocator of the heap entries.
+         */
+        explicit SeedHeap( const Allocator<char>::type& alloc) : _heap( alloc), _candidates( alloc)
+        {}
+
+    public: // methods
+
+        /** Inserts a point with its current reachability distance, or updates it if it is already contained.
+         * @param p The point. Its reachability distance must not have been increased since it was last pushed.
+         */
+        inline void push( DataPoint* p) {
+            Entry e = { p->reachability_distance(), p };
+            _heap.push_back( e);
+            std::push_heap( _heap.begin(), _heap.end(), Comp_Entry_f());
+        }
+
+        /** Removes the point with the smallest reachability distance.
+         * @return The point with the smallest reachability distance, or nullptr if the seed list is empty.
+         */
+        DataPoint* pop() {
+            while( !_heap.empty()) {
+                const Entry top = _heap.front();
+                std::pop_heap( _heap.begin(), _heap.end(), Comp_Entry_f());
+                _heap.pop_back();
+
+                if( !top.point->is_processed() && top.point->reachability_distance() == top.reachability_distance)
+                    return top.point;
+                // *** outdated entry ***
+            }
+            return nullptr;
+        }
+
+        /** Retrieves the points with the smallest reachability distances without removing them.
+         * The heap is searched best-first from the top, so this takes O(k log k) time
+         * plus the time for skipping outdated entries. Once the scratch memory has grown, no more allocations happen.
+         * @param k The maximum number of points to retrieve.
+         * @param o_top Receives the at most k points that pop() would return next, in that order.
+         *        The previous content is cleared.
+         */
+        void top( const std::size_t k, DataVector& o_top) {
+            o_top.clear();
+            std::vector<std::size_t, Allocator<std::size_t>::type>& candidates = _candidates;
+            candidates.clear();
+            const Comp_Candidate_f comp = { &_heap };
+            if( !_heap.empty())
+                candidates.push_back( 0);
+
+            while( !candidates.empty() && o_top.size() < k) {
+                std::pop_heap( candidates.begin(), candidates.end(), comp);
+                const std::size_t i = candidates.back();
+                candidates.pop_back();
+
+                const Entry& e = _heap[i];
+                if( !e.point->is_processed() && e.point->reachability_distance() == e.reachability_distance)
+                    o_top.push_back( e.point);
+
+                for( std::size_t child=2*i+1; child<=2*i+2 && child<_heap.size(); ++child) {
+                    candidates.push_back( child);
+                    std::push_heap( candidates.begin(), candidates.end(), comp);
+                }
+            }
+        }
+
+        /// Removes all entries while keeping the allocated memory.
+        inline void clear() { _heap.clear(); }
+
+        /** Reserves memory for a given number of entries.
+         * @param n The number of entries.
+         */
+        inline void reserve( const std::size_t n) { _heap.reserve( n); }
+    };
+
+
+    /** Implements the scratch memory of an OPTICS run.
+     * A Workspace is meant to be created once per run, or per thread, and to be reused
+     * for every call to expand_cluster_order(), so that the steady state of the algorithm
+     * does not allocate. A Workspace can be reused across runs.
+     */
+    class Workspace {
+
+    public: // vars
+
+        Neighborhood neighbors;         ///< The buffer for epsilon-neighborhoods, including the squared distances.
+        RealVector core_heap;           ///< The buffer for the bounded heap that finds core distances.
+        SeedHeap seeds;                 ///< The seeds priority queue.
+
+    public: // ctor & dtor
+
+        /// Default constructor. Creates a workspace without preallocated memory.
+        Workspace()
+        {}
+
+        /** Main constructor.
+         * Preallocates memory for a run.
+         * @param n The number of points of the database.
+         * @param min_pts The minimum number of points to be found within an epsilon-neigborhood.
+         */
+        Workspace( const std::size_t n, const unsigned int min_pts) {
+            reserve( n, min_pts);
+        }
+
+        /** Allocator-aware constructor. Creates a workspace without preallocated memory.
+         * All scratch memory of the runs on this workspace can so be taken from e.g.
+         * a MonotonicArena and be released at once afterwards.
+         * @param alloc The allocator of all buffers.
+         */
+        explicit Workspace( const Allocator<char>::type& alloc) : neighbors( alloc), core_heap( alloc), seeds( alloc)
+        {}
+
+    public: // methods
+
+        /** Preallocates memory for a run.
+         * @param n The number of points of the database.
+         * @param min_pts The minimum number of points to be found within an epsilon-neigborhood.
+         */
+        void reserve( const std::size_t n, const unsigned int min_pts) {
+            neighbors.reserve( n);
+            core_heap.reserve( min_pts+1);
+            seeds.reserve( n);
+        }
+    };
+
+} // END namespace OPTICS
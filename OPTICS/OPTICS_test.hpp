@@ -9,11 +9,14 @@ Functions and classes for testing OPTICS
 #include <random>
 #include <opencv2/opencv.hpp>
 
+#include "OPTICS/dedup.hpp"
+#include "OPTICS/hnsw.hpp"
 #include "OPTICS/optics.hpp"
+#include "OPTICS/persistence.hpp"
+#include "OPTICS/point_store.hpp"
 
 #include <barn_common.hpp>
 #include <barn_open_cv_common.hpp>
-#include <Persistence1D/src/persistence1d/persistence1d.hpp>
 
 using namespace cv;
 using namespace std;
@@ -193,11 +196,19 @@ void test_optics( const Mat3b& testset,
                   const unsigned int n_clusters, 
                   const bool use_n_clusters,
                   const float outlier_threshold);
-OPTICS::DataVector scan_testset( const Mat3b& testset);
+void compare_approximate_optics( const Mat3b& testset,
+                                 float eps,
+                                 const unsigned int min_pts,
+                                 const unsigned int ef_search);
+bool test_deduplicated_optics( const unsigned int n_datasets,
+                               const unsigned int n_points,
+                               float eps,
+                               const unsigned int min_pts);
+void scan_testset( const Mat3b& testset, OPTICS::PointStore& o_store);
 Mat3b build_histogram( const float rows, const vector<float>& reachabilities);
-std::vector<unsigned int> find_k_histogram_peaks( const vector<OPTICS::real>& reachabilities,
+std::vector<unsigned int> find_k_histogram_peaks( const OPTICS::Persistence& peaks,
                                                   const uint n_clusters);
-std::vector<unsigned int> find_histogram_peaks( const vector<OPTICS::real>& reachabilities, 
+std::vector<unsigned int> find_histogram_peaks( const OPTICS::Persistence& peaks, 
                                                 const OPTICS::real persistence);
 vector<Mat3b> create_cluster_images( const vector<OPTICS::DataVector>& clusters, unsigned int rows, unsigned int cols);
 
@@ -215,7 +226,7 @@ void test_optics( const Mat3b& testset,
 
     // adjust epsilon
     if( eps < 0) 
-        eps = std::numeric_limits<float>::max();
+        eps = OPTICS::UNDEFINED;
 
     // print parameters
     cout << ">>> epsilon    : " << eps << endl;
@@ -227,7 +238,9 @@ void test_optics( const Mat3b& testset,
     cout << ">>> outlier threshold : " << outlier_threshold << endl;
 
     // scan test set
-    OPTICS::DataVector db =  scan_testset(testset);
+    OPTICS::PointStore store;
+    scan_testset( testset, store);
+    OPTICS::DataVector& db = store.points();
 
     // shuffle data
     if( shuffle) {
@@ -270,12 +283,13 @@ void test_optics( const Mat3b& testset,
     // build histogram
     Mat3b hist = build_histogram( max_r_dist, reachabilities);
 
-    // find histogram maximum peaks
+    // find histogram maximum peaks; the persistence pairs are computed once and can be queried repeatedly
+    const OPTICS::Persistence peaks( reachabilities);
     std::vector<unsigned int> cluster_borders;
     if( use_n_clusters) {
-        cluster_borders = find_k_histogram_peaks( reachabilities, n_clusters);
+        cluster_borders = find_k_histogram_peaks( peaks, n_clusters);
     } else {
-        cluster_borders = find_histogram_peaks( reachabilities, persistence);
+        cluster_borders = find_histogram_peaks( peaks, persistence);
     }
     std::sort( cluster_borders.begin(), cluster_borders.end());
 
@@ -319,33 +333,156 @@ void test_optics( const Mat3b& testset,
     
     waitKey();
     destroyAllWindows();
+}
+
+/*
+*/
+void compare_approximate_optics( const Mat3b& testset,
+                                 float eps,
+                                 const unsigned int min_pts,
+                                 const unsigned int ef_search) {
+
+    // adjust epsilon
+    if( eps < 0)
+        eps = OPTICS::UNDEFINED;
+
+    // print parameters
+    cout << ">>> epsilon    : " << eps << endl;
+    cout << ">>> min_pts    : " << min_pts << endl;
+    cout << ">>> ef_search  : " << ef_search << endl;
+
+    // scan test set twice, so that both runs start on unprocessed points
+    OPTICS::PointStore exact_store;
+    OPTICS::PointStore approx_store;
+    scan_testset( testset, exact_store);
+    scan_testset( testset, approx_store);
+
+    cout << fixed;
+
+    // run exact and approximate optics
+    cout << "\nRunning exact OPTICS with " << exact_store.size() << " samples...\n";
+    int64 ticks = getTickCount();
+    OPTICS::DataVector exact = OPTICS::optics( exact_store.points(), eps, min_pts);
+    const double exact_seconds = (getTickCount() - ticks) / getTickFrequency();
+
+    cout << "Running approximate OPTICS with " << approx_store.size() << " samples...\n";
+    ticks = getTickCount();
+    OPTICS::HNSWIndex index( approx_store.points(), 16, 128, ef_search);
+    OPTICS::DataVector approx = OPTICS::optics_indexed( approx_store.points(), index, eps, min_pts);
+    const double approx_seconds = (getTickCount() - ticks) / getTickFrequency();
+
+    // compare core distances point by point
+    unsigned int n_equal_cores = 0;
+    for( unsigned int i=0; i<exact_store.size(); ++i)
+        if( exact_store[i].core_distance() == approx_store[i].core_distance())
+            ++n_equal_cores;
+
+    // compare reachability plots position by position
+    vector<float> exact_reachabilities;
+    vector<float> approx_reachabilities;
+    std::for_each(exact.begin(), exact.end(), [&exact_reachabilities]( const OPTICS::DataPoint* p) { exact_reachabilities.push_back( p->reachability_distance()); });
+    std::for_each(approx.begin(), approx.end(), [&approx_reachabilities]( const OPTICS::DataPoint* p) { approx_reachabilities.push_back( p->reachability_distance()); });
+
+    unsigned int n_undefined_mismatches = 0;
+    unsigned int n_compared = 0;
+    double abs_error = 0;
+    for( unsigned int i=0; i<exact_reachabilities.size(); ++i) {
+        const bool exact_undefined = exact_reachabilities[i] == OPTICS::UNDEFINED;
+        const bool approx_undefined = approx_reachabilities[i] == OPTICS::UNDEFINED;
+        if( exact_undefined != approx_undefined) {
+            ++n_undefined_mismatches;
+        } else if( !exact_undefined) {
+            abs_error += std::abs( std::sqrt( exact_reachabilities[i]) - std::sqrt( approx_reachabilities[i]));
+            ++n_compared;
+        }
+    }
+
+    cout << "exact       : " << setprecision(3) << exact_seconds << " s\n";
+    cout << "approximate : " << setprecision(3) << approx_seconds << " s\n";
+    cout << "equal core distances          : " << setprecision(2) << 100.0 * n_equal_cores / exact_store.size() << "%\n";
+    cout << "unreachable mismatches        : " << n_undefined_mismatches << "\n";
+    cout << "mean abs reachability error   : " << setprecision(4) << (n_compared > 0 ? abs_error / n_compared : 0.0) << "\n";
+
+    // build both histograms on the same scale, exact on top
+    auto max_defined = []( float a, float b){ return a == OPTICS::UNDEFINED ? true : a<b; };
+    const float max_r_dist = std::max( *std::max_element( exact_reachabilities.begin(), exact_reachabilities.end(), max_defined),
+                                       *std::max_element( approx_reachabilities.begin(), approx_reachabilities.end(), max_defined));
+    Mat3b hists;
+    vconcat( build_histogram( max_r_dist, exact_reachabilities), build_histogram( max_r_dist, approx_reachabilities), hists);
+
+    namedWindow( winname_hist, WINDOW_NORMAL);
+    imshow( winname_hist, hists);
+    imwrite( "hist_compare.png", hists);
+
+    waitKey();
+    destroyAllWindows();
+}
+
+/*
+runs optics() and optics_deduplicated() on random quantized 2D data sets and checks that both
+produce the same ordering with the same reachability and core distances
+*/
+bool test_deduplicated_optics( const unsigned int n_datasets,
+                               const unsigned int n_points,
+                               float eps,
+                               const unsigned int min_pts) {
 
-    // cleanup
-    for( auto it = db.begin(); it!=db.end(); ++it) {
-        delete *it;
+    // adjust epsilon
+    if( eps < 0)
+        eps = OPTICS::UNDEFINED;
+
+    unsigned int n_mismatches = 0;
+    for( unsigned int s=0; s<n_datasets; ++s) {
+        std::mt19937 generator( s);
+        std::uniform_int_distribution<int> coordinate( 0, 10);
+        vector<float> coords( 2*n_points);
+        for( auto it=coords.begin(); it!=coords.end(); ++it)
+            *it = (float)coordinate( generator);
+
+        // the stores keep the points in database order, so both runs break ties alike
+        OPTICS::PointStore full_store( coords.data(), n_points, 2);
+        OPTICS::PointStore dedup_store( coords.data(), n_points, 2);
+        const OPTICS::DataVector full = OPTICS::optics( full_store.points(), eps, min_pts);
+        const OPTICS::DataVector dedup = OPTICS::optics_deduplicated( dedup_store.points(), eps, min_pts);
+
+        bool is_equal = full.size() == dedup.size();
+        for( unsigned int i=0; is_equal && i<full.size(); ++i) {
+            is_equal = full_store.index_of( full[i]) == dedup_store.index_of( dedup[i])
+                    && full[i]->reachability_distance() == dedup[i]->reachability_distance()
+                    && full[i]->core_distance() == dedup[i]->core_distance();
+        }
+        if( !is_equal) {
+            cout << "data set " << s << ": optics_deduplicated() differs from optics()\n";
+            ++n_mismatches;
+        }
     }
+    cout << n_mismatches << " of " << n_datasets << " deduplicated runs differ from optics()\n";
+    return n_mismatches == 0;
 }
 
 /*
 */
-OPTICS::DataVector scan_testset( const Mat3b& testset) {
+void scan_testset( const Mat3b& testset, OPTICS::PointStore& o_store) {
 
     cout << "Scanning " << testset.rows << " x " << testset.cols << " test set... ";
-    OPTICS::DataVector db;
+    vector<float> coords;
     for( int r=0; r<testset.rows; ++r)
     for( int c=0; c<testset.cols; ++c) {
         if( r%50 == 0 && c==0)
             cout << r << "   ";
 
         if( testset( r, c)[0] > 128) {
-            OPTICS::DataPoint* p = new OPTICS::DataPoint();
-            p->data().push_back( (float)r);
-            p->data().push_back( (float)c);
-            db.push_back( p);
+            coords.push_back( (float)r);
+            coords.push_back( (float)c);
         }
     }
     cout << endl;
-    return db;
+
+    o_store.reset( coords.size() / 2, 2);
+    for( unsigned int i=0; i<o_store.size(); ++i) {
+        o_store[i].data()[0] = coords[2*i];
+        o_store[i].data()[1] = coords[2*i+1];
+    }
 }
 
 /*
@@ -356,21 +493,23 @@ Mat3b build_histogram( const float max_r_dist, const vector<float>& reachabiliti
     const unsigned int rows = static_cast<unsigned int>(frows);
 
     Mat3b ret( rows, reachabilities.size(), color_background);
-    for( int c=0; c<ret.cols; ++c) {
-        for( int r=0; r<ret.rows; ++r) {
+    OPTICS::default_pool().parallel_for( 0, ret.cols, 256, [&]( const size_t lower_col, const size_t upper_col) {
+        for( int c=(int)lower_col; c<(int)upper_col; ++c) {
+            for( int r=0; r<ret.rows; ++r) {
             
-            if( (float)reachabilities[c]/rows > (float)(rows-r)/rows)
-                ret(r,c) = color_hist_bar;
-            if( reachabilities[c] == OPTICS::UNDEFINED)
-                ret(r,c) = color_hist_unreachable;
+                if( (float)reachabilities[c]/rows > (float)(rows-r)/rows)
+                    ret(r,c) = color_hist_bar;
+                if( reachabilities[c] == OPTICS::UNDEFINED)
+                    ret(r,c) = color_hist_unreachable;
+            }
         }
-    }
+    });
     return ret;
 }
 
-/** Given the OPTICS ordered output, finds the k most persistent maxima peaks 
+/** Given the persistence pairs of the OPTICS ordered output, finds the k most persistent maxima peaks 
  * of the reachability distances, which are presumably cluster-borders.
- * @param reachabilities The OPTICS ordered reachability distances of the DataPoints 
+ * @param peaks The persistence pairs of the OPTICS ordered reachability distances of the DataPoints 
  *        that where the input of the OPTICS function.
  * @param n_clusters the number of clusters that shall is we want to extract.
  *        The n_clusters-1 most persistent histogram peaks are assumed to be their borders.
@@ -379,44 +518,24 @@ Mat3b build_histogram( const float max_r_dist, const vector<float>& reachabiliti
  *         The indices are ordered in descending order to the persistence of the peaks at these positions.
  * @see optics()
  */
-std::vector<unsigned int> find_k_histogram_peaks( const vector<OPTICS::real>& reachabilities,
+std::vector<unsigned int> find_k_histogram_peaks( const OPTICS::Persistence& peaks,
                                                   const uint n_clusters) {
-    std::vector<unsigned int> ret;
-
-    p1d::Persistence1D p;
-    p.RunPersistence(reachabilities);
-    vector<p1d::TPairedExtrema> extrema;
-    p.GetPairedExtrema(extrema, 0);
-
-    unsigned int n=1;
-    for( int i=extrema.size()-1; i>=0 && n<n_clusters; --i, ++n)
-        ret.push_back( extrema[i].MaxIndex);
-
-    return ret;
+    return peaks.most_persistent_peaks( n_clusters > 0 ? n_clusters-1 : 0);
 }
 
 
-/** Given the OPTICS ordered output, finds all maxima peaks with a persistence 
+/** Given the persistence pairs of the OPTICS ordered output, finds all maxima peaks with a persistence 
  * greater than a given threshold. These are presumably cluster-borders.
- * @param reachabilities The OPTICS ordered reachability distances of the DataPoints 
+ * @param peaks The persistence pairs of the OPTICS ordered reachability distances of the DataPoints 
  *        that where the input of the OPTICS function.
  * @param persistence The persistence of the histogram peaks to retain.
  * @return All histogram peak indices that are above the given persistence threshold.
- *         The indices are ordered in ascending order to the persistence of the peaks at these positions.
+ *         The indices are ordered in descending order to the persistence of the peaks at these positions.
  * @see optics()
  */
-std::vector<unsigned int> find_histogram_peaks( const vector<OPTICS::real>& reachabilities, 
+std::vector<unsigned int> find_histogram_peaks( const OPTICS::Persistence& peaks, 
                                                 const OPTICS::real persistence) {
-    std::vector<unsigned int> ret;
-
-    p1d::Persistence1D p;
-    p.RunPersistence(reachabilities);
-    vector<p1d::TPairedExtrema> extrema;
-    p.GetPairedExtrema(extrema, persistence);
-
-    std::for_each(extrema.begin(), extrema.end(), [&ret]( const p1d::TPairedExtrema& e) { ret.push_back( e.MaxIndex); });
-
-    return ret;
+    return peaks.peaks_above( persistence);
 }
 
 /*
@@ -12,7 +12,6 @@ Main cpp for testing OPTICS
 
 #include <barn_common.hpp>
 #include <barn_open_cv_common.hpp>
-#include <Persistence1D/src/persistence1d/persistence1d.hpp>
 
 #include "OPTICS_test.hpp"
 
@@ -31,33 +30,67 @@ void main() {
 
     while(1) {
 
+        unsigned int test;
         float eps= -1;
         unsigned int min_pts;
-        float persistence = -1;
-        unsigned int n_clusters;
-        bool use_n_clusters;
-        float outlier_threshold;
+        cout << "test (0: optics, 1: exact vs. approximate optics, 2: deduplicated optics) : "; cin >> test;
         cout << "epsilon : "; cin >> eps;
         cout << "min_pts : "; cin >> min_pts;
-        cout << "oose n_clusters instead of persistence? : "; cin >> use_n_clusters;
-        if( use_n_clusters) {
-            cout << "n_clusters : "; cin >> n_clusters;
-        } else {
-            cout << "persistence : "; cin >> persistence;
+
+        switch( test) {
+        case 1: {
+            unsigned int ef_search;
+            cout << "ef_search : "; cin >> ef_search;
+
+            cout << endl;
+
+            compare_approximate_optics( testset,
+                                        eps,
+                                        min_pts,
+                                        ef_search);
+            break;
         }
-        cout << "outlier threshold : "; cin >> outlier_threshold;
+        case 2: {
+            unsigned int n_datasets;
+            unsigned int n_points;
+            cout << "n_datasets : "; cin >> n_datasets;
+            cout << "n_points : "; cin >> n_points;
+
+            cout << endl;
 
-        cout << endl;
+            test_deduplicated_optics( n_datasets,
+                                      n_points,
+                                      eps,
+                                      min_pts);
+            break;
+        }
+        default: {
+            float persistence = -1;
+            unsigned int n_clusters;
+            bool use_n_clusters;
+            float outlier_threshold;
+            cout << "oose n_clusters instead of persistence? : "; cin >> use_n_clusters;
+            if( use_n_clusters) {
+                cout << "n_clusters : "; cin >> n_clusters;
+            } else {
+                cout << "persistence : "; cin >> persistence;
+            }
+            cout << "outlier threshold : "; cin >> outlier_threshold;
+
+            cout << endl;
         
 
-        test_optics( testset, 
-                  false,
-                  eps, 
-                  min_pts, 
-                  persistence, 
-                  n_clusters, 
-                  use_n_clusters, 
-                  outlier_threshold);
+            test_optics( testset, 
+                      false,
+                      eps, 
+                      min_pts, 
+                      persistence, 
+                      n_clusters, 
+                      use_n_clusters, 
+                      outlier_threshold);
+            break;
+        }
+        } // END switch( test)
         cout << "===============================================================================\n";
 
     } // END while(1)